@@ -0,0 +1,109 @@
+#include "attacks.h"
+#ifdef PEXT_AVAILABLE
+#include <cpuid.h>
+#endif
+
+namespace attacks {
+
+constexpr std::array<PextEntry, 64> calculatePextEntries(bool isBishop) {
+    std::array<PextEntry, 64> entries;
+    // The rook attack sets are stored after all of the bishop ones
+    uint32_t offset = isBishop ? 0 : BISHOP_TABLE_SIZE;
+    for (int square = 0; square < 64; square++) {
+        uint64_t mask = isBishop ? magics::bishopOccupancyMasks[square] : magics::rookOccupancyMasks[square];
+        entries[square] = PextEntry(mask, offset);
+        offset += 1 << std::popcount(mask);
+    }
+    return entries;
+}
+
+constexpr std::array<PextEntry, 64> bishopPextEntries = calculatePextEntries(true);
+constexpr std::array<PextEntry, 64> rookPextEntries = calculatePextEntries(false);
+
+constexpr std::array<uint64_t, BISHOP_TABLE_SIZE + ROOK_TABLE_SIZE> calculatePextAttackTable() {
+    std::array<uint64_t, BISHOP_TABLE_SIZE + ROOK_TABLE_SIZE> table = {};
+
+    for (int square = 0; square < 64; square++) {
+        for (bool isBishop : {true, false}) {
+            const PextEntry &entry = isBishop ? bishopPextEntries[square] : rookPextEntries[square];
+            // Carry-rippler subsets of the mask come in increasing order of their PEXT index
+            uint64_t occupancy = 0;
+            uint32_t index = 0;
+            do {
+                table[entry.offset + index++] = isBishop ? magics::calculateBishopBlockMask(square, occupancy)
+                                                         : magics::calculateRookBlockMask(square, occupancy);
+                occupancy = (occupancy - entry.mask) & entry.mask;
+            } while (occupancy);
+        }
+    }
+
+    return table;
+}
+
+alignas(64) constexpr std::array<uint64_t, BISHOP_TABLE_SIZE + ROOK_TABLE_SIZE> pextAttackTable =
+    calculatePextAttackTable();
+
+#if defined(PEXT_AVAILABLE) && !defined(__BMI2__)
+__attribute__((target("bmi2"))) uint64_t pextBishop(int square, uint64_t occupancy) {
+    const PextEntry &entry = bishopPextEntries[square];
+    return pextAttackTable[entry.offset + _pext_u64(occupancy, entry.mask)];
+}
+
+__attribute__((target("bmi2"))) uint64_t pextRook(int square, uint64_t occupancy) {
+    const PextEntry &entry = rookPextEntries[square];
+    return pextAttackTable[entry.offset + _pext_u64(occupancy, entry.mask)];
+}
+#elif !defined(PEXT_AVAILABLE)
+// Never called, as the PEXT backend can't be selected without the instruction
+uint64_t pextBishop(int square, uint64_t occupancy) { return magics::bishopAttacks(square, occupancy); }
+
+uint64_t pextRook(int square, uint64_t occupancy) { return magics::rookAttacks(square, occupancy); }
+#endif
+
+bool isPextSupported() {
+#if defined(__BMI2__)
+    return true;
+#elif defined(PEXT_AVAILABLE)
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("bmi2");
+#else
+    return false;
+#endif
+}
+
+/* AMD processors before Zen 3 (family 19h) implement PEXT in microcode, which makes it much slower than a magic
+ * lookup. Building with BMI2 enabled is taken as a request for PEXT regardless. */
+bool isPextFast() {
+#if defined(__BMI2__)
+    return true;
+#elif defined(PEXT_AVAILABLE)
+    unsigned int eax, ebx, ecx, edx;
+    if (!__get_cpuid(0, &eax, &ebx, &ecx, &edx)) {
+        return false;
+    }
+    // The vendor string "AuthenticAMD" is split across ebx, edx and ecx
+    bool isAmd = ebx == 0x68747541 && edx == 0x69746e65 && ecx == 0x444d4163;
+    if (!isAmd) {
+        return true;
+    }
+    __get_cpuid(1, &eax, &ebx, &ecx, &edx);
+    unsigned int family = (eax >> 8 & 0xf) + (eax >> 20 & 0xff);
+    return family >= 0x19;
+#else
+    return false;
+#endif
+}
+
+int backend = isPextSupported() && isPextFast() ? BACKEND_PEXT : BACKEND_MAGIC;
+
+bool setBackend(int newBackend) {
+    if (newBackend == BACKEND_PEXT && !isPextSupported()) {
+        return false;
+    }
+    backend = newBackend;
+    return true;
+}
+
+const char *getBackendName() { return backend == BACKEND_PEXT ? "pext" : "magic"; }
+
+} // namespace attacks
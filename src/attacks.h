@@ -0,0 +1,68 @@
+#ifndef ATTACKS_H
+#define ATTACKS_H
+
+#include "magics.h"
+#include <array>
+#include <cstdint>
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#include <immintrin.h>
+#define PEXT_AVAILABLE
+#endif
+
+/* Slider attacks for a square and board occupancy, looked up either with magic multiplication or with the BMI2 PEXT
+ * instruction. PEXT is used by default when the CPU supports it and implements it in hardware. Building with BMI2
+ * enabled (-mbmi2) lets the PEXT lookups be inlined. */
+namespace attacks {
+
+#define BACKEND_MAGIC 0
+#define BACKEND_PEXT 1
+
+struct PextEntry {
+    uint64_t mask;
+    uint32_t offset;
+};
+
+extern const std::array<PextEntry, 64> bishopPextEntries;
+extern const std::array<PextEntry, 64> rookPextEntries;
+extern const std::array<uint64_t, BISHOP_TABLE_SIZE + ROOK_TABLE_SIZE> pextAttackTable;
+
+extern int backend;
+
+bool isPextSupported();
+bool isPextFast();
+bool setBackend(int newBackend);
+const char *getBackendName();
+
+#ifdef __BMI2__
+inline uint64_t pextBishop(int square, uint64_t occupancy) {
+    const PextEntry &entry = bishopPextEntries[square];
+    return pextAttackTable[entry.offset + _pext_u64(occupancy, entry.mask)];
+}
+
+inline uint64_t pextRook(int square, uint64_t occupancy) {
+    const PextEntry &entry = rookPextEntries[square];
+    return pextAttackTable[entry.offset + _pext_u64(occupancy, entry.mask)];
+}
+#else
+uint64_t pextBishop(int square, uint64_t occupancy);
+uint64_t pextRook(int square, uint64_t occupancy);
+#endif
+
+inline uint64_t bishop(int square, uint64_t occupancy) {
+    if (backend == BACKEND_PEXT) {
+        return pextBishop(square, occupancy);
+    }
+    return magics::bishopAttacks(square, occupancy);
+}
+
+inline uint64_t rook(int square, uint64_t occupancy) {
+    if (backend == BACKEND_PEXT) {
+        return pextRook(square, occupancy);
+    }
+    return magics::rookAttacks(square, occupancy);
+}
+
+} // namespace attacks
+
+#endif
@@ -0,0 +1,64 @@
+#include "bench.h"
+#include "board.h"
+#include "search.h"
+#include <array>
+#include <chrono>
+#include <iostream>
+#include <string>
+
+namespace bench {
+
+/* Measures time to depth on a set of positions with an increasing number of search threads. The statistics of every
+ * iteration are also printed to stderr as JSON lines. */
+void searchBenchmark(int depth) {
+    const std::array<std::string, 4> positions = {
+        "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+        "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+        "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+        "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+    };
+    SearchLimits limits;
+    limits.depth = depth;
+    double singleThreadTime = 0;
+
+    for (int threads = 1; threads <= 16; threads *= 2) {
+        Searcher searcher;
+        searcher.setThreads(threads);
+#ifdef SEARCH_STATS
+        searcher.setInfoCallback([](const SearchInfo &info) { std::cerr << formatStatsJson(info) << '\n'; });
+#endif
+        uint64_t nodes = 0;
+        SearchStats stats;
+        double timeElapsed = 0;
+        for (const std::string &position : positions) {
+            // Each search starts cold, so neither earlier positions nor thread counts warm the table and history.
+            // Clearing them isn't timed.
+            searcher.newGame();
+            Board board(position);
+            auto start = std::chrono::steady_clock::now();
+            searcher.getBestMove(board, limits);
+            timeElapsed +=
+                std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+            nodes += searcher.getNodes();
+            stats.add(searcher.getStats());
+        }
+        if (threads == 1) {
+            singleThreadTime = timeElapsed;
+        }
+        double nps = timeElapsed ? (double)nodes / timeElapsed * 1000000 : 0;
+
+        std::cout << threads << " threads: " << timeElapsed / 1000 << "ms, " << nodes << " nodes @ " << nps
+                  << "n/s, speedup " << singleThreadTime / timeElapsed << '\n';
+        std::cout << "  seldepth " << stats.selDepth << ", qnodes " << stats.qNodes << ", first move cutoffs "
+                  << stats.firstMoveCutoffs << "/" << stats.betaCutoffs << ", tt hits " << stats.ttHits << "/"
+                  << stats.ttProbes << '\n';
+        std::cout << "  null move cutoffs " << stats.nullMoveCutoffs << "/" << stats.nullMoveSearches
+                  << ", reduced re-searches " << stats.reSearches << "/" << stats.reducedSearches
+                  << ", null window re-searches " << stats.pvsReSearches << ", aspiration fails "
+                  << stats.aspirationFails << '\n';
+        std::cout << "  reverse futility prunes " << stats.reverseFutilityPrunes << ", futility prunes "
+                  << stats.futilityPrunes << ", delta prunes " << stats.deltaPrunes << '\n';
+    }
+}
+
+} // namespace bench
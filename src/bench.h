@@ -0,0 +1,10 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+namespace bench {
+
+void searchBenchmark(int depth);
+
+} // namespace bench
+
+#endif
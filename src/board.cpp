@@ -1,4 +1,6 @@
 #include "board.h"
+#include "attacks.h"
+#include "evaluate.h"
 #include "magics.h"
 #include "masks.h"
 #include <algorithm>
@@ -16,16 +18,58 @@
 #define KING 6
 #define BLACK 8
 
-Board::Board(std::string startingPos) {
+Board::Board(std::string startingPos) : history(INITIAL_HISTORY_SIZE), ply(0), repetitionFilter() {
+    position = &history[0];
+    *position = Position();
     convertFromFen(startingPos);
-    setup();
+    repetitionFilter[position->hash % REPETITION_FILTER_SIZE]++;
+    isSetUp = false;
+    isCheckStatusKnown = false;
+}
+
+/* Only the history up to the current ply is copied, as the slots after it are scratch space. The position pointer has
+ * to be pointed at the copied history rather than the original's. The cached move list isn't copied either, the copy
+ * generates it again if it is asked for. */
+Board::Board(const Board &other)
+    : ply(other.ply), repetitionFilter(other.repetitionFilter), gameStatus(other.gameStatus),
+      numChecks(other.numChecks), opponentAttackMap(other.opponentAttackMap),
+      checkEvasionMask(other.checkEvasionMask), pinnedPieces(other.pinnedPieces), isSetUp(false),
+      isCheckStatusKnown(other.isCheckStatusKnown) {
+    history.reserve(std::max(ply + 1, INITIAL_HISTORY_SIZE));
+    history.assign(other.history.begin(), other.history.begin() + ply + 1);
+    position = &history[ply];
+}
+
+// Assigning into an existing board reuses its history storage, so a search thread's board doesn't allocate
+Board &Board::operator=(const Board &other) {
+    if (this == &other) {
+        return *this;
+    }
+    ply = other.ply;
+    history.assign(other.history.begin(), other.history.begin() + ply + 1);
+    position = &history[ply];
+    repetitionFilter = other.repetitionFilter;
+    gameStatus = other.gameStatus;
+    numChecks = other.numChecks;
+    opponentAttackMap = other.opponentAttackMap;
+    checkEvasionMask = other.checkEvasionMask;
+    pinnedPieces = other.pinnedPieces;
+    isSetUp = false;
+    isCheckStatusKnown = other.isCheckStatusKnown;
+    return *this;
+}
+
+// Check detection, pins, move generation and the game status are only calculated once the position is queried, so
+// making and unmaking moves only has to update the board itself.
+void Board::ensureSetUp() {
+    if (!isSetUp) {
+        setup();
+    }
 }
 
 void Board::setup() {
-    moves.reserve(40);
-    determineCheckStatus();
-    calculatePinnedPieces();
-    generateLegalMoves();
+    isSetUp = true;
+    generateMoves(moves);
     gameStatus = 0;
 
     if (moves.size() == 0) {
@@ -37,36 +81,130 @@ void Board::setup() {
             gameStatus = 2;
         }
     }
-    // 50 move rule
-    if (halfMoves >= 100) {
+    if (isDraw()) {
         gameStatus = 2;
     }
+}
+
+// Fills moveList with the legal moves in the current position without touching the cached move list.
+void Board::generateMoves(MoveList &moveList) {
+    moveList.clear();
+    if (position->isWhiteTurn) {
+        generateLegalMoves<White, GENERATE_ALL>(moveList);
+    } else {
+        generateLegalMoves<Black, GENERATE_ALL>(moveList);
+    }
+}
+
+// Appends the legal captures and promotions, so quiescence search never generates quiet moves.
+void Board::generateCaptures(MoveList &moveList) {
+    if (position->isWhiteTurn) {
+        generateLegalMoves<White, GENERATE_CAPTURES>(moveList);
+    } else {
+        generateLegalMoves<Black, GENERATE_CAPTURES>(moveList);
+    }
+}
+
+// Appends the legal moves not produced by generateCaptures.
+void Board::generateQuiets(MoveList &moveList) {
+    if (position->isWhiteTurn) {
+        generateLegalMoves<White, GENERATE_QUIETS>(moveList);
+    } else {
+        generateLegalMoves<Black, GENERATE_QUIETS>(moveList);
+    }
+}
 
-    // Three move repetition
+bool Board::isInCheck() {
+    if (!isCheckStatusKnown) {
+        position->isWhiteTurn ? determineCheckStatus<White>() : determineCheckStatus<Black>();
+        isCheckStatusKnown = true;
+    }
+    return numChecks;
+}
+
+bool Board::isLegalQuiet(Move move) {
+    return position->isWhiteTurn ? isLegalQuiet<White>(move) : isLegalQuiet<Black>(move);
+}
+
+/* Draws by the 50 move rule or three move repetition. Stalemate is only detected once moves are generated. Inside a
+ * search, a single repetition of a position reached after the search root (searchPly moves ago) is already scored as a
+ * draw, as the side that allowed it could have repeated again. */
+bool Board::isDraw(int searchPly) {
+    if (position->halfMoves >= 100) {
+        return true;
+    }
+    if (repetitionFilter[position->hash % REPETITION_FILTER_SIZE] < 2) {
+        return false;
+    }
+
+    // Only positions with the same side to move since the last capture or pawn move can repeat, and the nearest one is
+    // four plies back
     int repetitions = 0;
-    for (int i = repetitionStart; i < zobristHashes.size(); i++) {
-        if (zobristHashes[i] == currentPositionHash) {
-            repetitions++;
+    int oldest = std::max(ply - position->halfMoves, 0);
+    for (int i = ply - 4; i >= oldest; i -= 2) {
+        if (history[i].hash == position->hash) {
+            if (i > ply - searchPly || ++repetitions == 2) {
+                return true;
+            }
         }
     }
-    if (repetitions >= 2) {
-        gameStatus = 2;
+    return false;
+}
+
+std::array<uint8_t, 64> Board::getState() {
+    std::array<uint8_t, 64> state;
+    for (int square = 0; square < 64; square++) {
+        state[square] = pieceOn(square);
+    }
+    return state;
+}
+
+short Board::getPiece(int square) { return pieceOn(square); }
+
+// Position has no mailbox, so the piece on a square is looked up in the bitboards of the colour occupying it
+int Board::pieceOn(int square) {
+    uint64_t squareBitboard = 1ULL << square;
+    int colour = position->bitboards[WHITE] & squareBitboard ? WHITE : BLACK;
+    if (!(position->bitboards[colour] & squareBitboard)) {
+        return 0;
     }
+    int piece = PAWN;
+    while (!(position->bitboards[colour + piece] & squareBitboard)) {
+        piece++;
+    }
+    return colour + piece;
+}
+
+bool Board::isOccupied(int square) { return (position->bitboards[WHITE] | position->bitboards[BLACK]) >> square & 1; }
+
+const MoveList &Board::getMoves() {
+    ensureSetUp();
+    return moves;
 }
 
-std::array<short, 64> Board::getState() { return state; }
+uint64_t Board::getBitboard(int index) { return position->bitboards[index]; }
+
+uint64_t Board::getHash() { return position->hash; }
 
-std::vector<Move> Board::getMoves() { return moves; }
+int Board::getMidgameScore() { return position->midgameScore; }
 
-uint64_t Board::getBitboard(int index) { return bitboards[index]; }
+int Board::getEndgameScore() { return position->endgameScore; }
 
-short Board::getEnPassantSquare() { return enPassantSquare; }
+int Board::getPhase() { return position->phase; }
 
-bool Board::getIsWhiteTurn() { return isWhiteTurn; }
+short Board::getEnPassantSquare() { return position->enPassantSquare; }
 
-uint64_t Board::getOpponentAttackMap() { return opponentAttackMap; }
+bool Board::getIsWhiteTurn() { return position->isWhiteTurn; }
 
-short Board::getGameStatus() { return gameStatus; }
+uint64_t Board::getOpponentAttackMap() {
+    ensureSetUp();
+    return opponentAttackMap;
+}
+
+short Board::getGameStatus() {
+    ensureSetUp();
+    return gameStatus;
+}
 
 void Board::convertFromFen(std::string fenString) {
     std::map<char, int> pieceLetterToPieceNum = {{'p', 1}, {'n', 2}, {'b', 3}, {'r', 4}, {'q', 5}, {'k', 6}};
@@ -89,17 +227,16 @@ void Board::convertFromFen(std::string fenString) {
         } else {
             int colourValue = islower(c) ? BLACK : WHITE;
             int value = colourValue + pieceLetterToPieceNum.at(tolower(c));
-            state[rank * 8 + file] = value;
-            bitboards[value] |= 1ULL << (rank * 8 + file);
-            bitboards[colourValue] |= 1ULL << (rank * 8 + file);
+            position->bitboards[value] |= 1ULL << (rank * 8 + file);
+            position->bitboards[colourValue] |= 1ULL << (rank * 8 + file);
             file++;
         }
     }
 
     if (segments[1] == "w") {
-        isWhiteTurn = true;
+        position->isWhiteTurn = true;
     } else if (segments[1] == "b") {
-        isWhiteTurn = false;
+        position->isWhiteTurn = false;
     }
 
     int castlingValue = 0;
@@ -117,53 +254,92 @@ void Board::convertFromFen(std::string fenString) {
             castlingValue += 1;
         }
     }
-    castlingRights = castlingValue;
+    position->castlingRights = castlingValue;
 
     if (segments[3] == "-") {
-        enPassantSquare = -1;
+        position->enPassantSquare = -1;
     }
     if (segments[3].length() == 2) {
-        enPassantSquare = (segments[3][1] - '0' - 1) * 8 + (segments[3][0] - 97);
+        position->enPassantSquare = (segments[3][1] - '0' - 1) * 8 + (segments[3][0] - 97);
     }
 
-    ply = 0;
-    repetitionStart = 0;
-    halfMoves = segments[4][0] - '0';
-    fullMoves = segments[5][0] - '0';
-    currentPositionHash = zobrist();
+    position->halfMoves = segments[4][0] - '0';
+    position->fullMoves = segments[5][0] - '0';
+    position->hash = zobrist();
+    calculateScores();
 }
 
 uint64_t Board::zobrist() {
     uint64_t hash = 0;
     for (int i = 0; i < 64; i++) {
-        int piece = state[i];
+        int piece = pieceOn(i);
         if (piece) {
             hash ^= magics::zobristKeys[(piece - 1 - (piece / 8) * 2) * 64 + i];
         }
     }
-    if (!isWhiteTurn) {
+    if (!position->isWhiteTurn) {
         hash ^= magics::zobristKeys[768];
     }
-    hash ^= magics::zobristKeys[769 + castlingRights];
-    if (enPassantSquare != -1) {
-        int enPassantFile = enPassantSquare & 7;
+    hash ^= magics::zobristKeys[769 + position->castlingRights];
+    if (position->enPassantSquare != -1) {
+        int enPassantFile = position->enPassantSquare & 7;
         hash ^= magics::zobristKeys[785 + enPassantFile];
     }
     return hash;
 }
 
-void Board::determineCheckStatus() {
+void Board::calculateScores() {
+    position->midgameScore = 0;
+    position->endgameScore = 0;
+    position->phase = 0;
+    for (int i = 0; i < 64; i++) {
+        if (int piece = pieceOn(i)) {
+            updateScores(piece, i, 1);
+        }
+    }
+}
+
+// Adds (sign = 1) or removes (sign = -1) a piece's contribution to the evaluation terms
+void Board::updateScores(int piece, int square, int sign) {
+    position->midgameScore += sign * evaluate::midgameScores[piece][square];
+    position->endgameScore += sign * evaluate::endgameScores[piece][square];
+    position->phase += sign * evaluate::phaseValues[piece];
+}
+
+// Pawn moves as square offsets from a side's own point of view, and the rank its pawns start on
+template <Colour Us> constexpr int forward = Us == White ? 8 : -8;
+template <Colour Us> constexpr int forwardWest = Us == White ? 7 : -9;
+template <Colour Us> constexpr int forwardEast = Us == White ? 9 : -7;
+template <Colour Us> constexpr uint64_t pawnStartRank = Us == White ? 0xff00 : 0xff000000000000;
+template <Colour Us> constexpr uint64_t promotionRank = Us == White ? 0xff00000000000000 : 0xff;
+
+// Squares a non-pawn move of the given generation type can land on
+template <Colour Us, int Type> uint64_t moveTargets(const std::array<uint64_t, 15> &bitboards) {
+    constexpr Colour Them = Us == White ? Black : White;
+    if constexpr (Type == GENERATE_CAPTURES) {
+        return bitboards[Them];
+    } else if constexpr (Type == GENERATE_QUIETS) {
+        return ~(bitboards[WHITE] | bitboards[BLACK]);
+    } else {
+        return ~bitboards[Us];
+    }
+}
+
+template <int Offset> constexpr uint64_t shift(uint64_t bitboard) {
+    return Offset > 0 ? bitboard << Offset : bitboard >> -Offset;
+}
+
+template <Colour Us> void Board::determineCheckStatus() {
     checkEvasionMask = 0xffffffffffffffff;
     numChecks = 0;
-    uint64_t pawnAttacks = generatePawnAttackMaps();
-    uint64_t knightAttacks = generateKnightAttackMaps();
-    uint64_t slidingAttacks = generateSlidingAttackMaps();
-    uint64_t kingAttacks = generateKingAttackMaps();
+    uint64_t pawnAttacks = generatePawnAttackMaps<Us>();
+    uint64_t knightAttacks = generateKnightAttackMaps<Us>();
+    uint64_t slidingAttacks = generateSlidingAttackMaps<Us>();
+    uint64_t kingAttacks = generateKingAttackMaps<Us>();
 
     opponentAttackMap = pawnAttacks | knightAttacks | slidingAttacks | kingAttacks;
 
-    int colourValue = isWhiteTurn ? WHITE : BLACK;
-    uint64_t kingLocation = bitboards[colourValue + KING];
+    uint64_t kingLocation = position->bitboards[Us + KING];
     if (pawnAttacks & kingLocation) {
         numChecks++;
     }
@@ -175,56 +351,31 @@ void Board::determineCheckStatus() {
     }
 }
 
-uint64_t Board::generatePawnAttackMaps() {
-    uint64_t attackMap = 0;
+template <Colour Us> uint64_t Board::generatePawnAttackMaps() {
+    constexpr Colour Them = Us == White ? Black : White;
     uint64_t attackingPawnMap = 0;
-    if (isWhiteTurn) {
-        uint64_t oppositionKingBitboard = bitboards[WHITE + KING];
+    uint64_t oppositionKingBitboard = position->bitboards[Us + KING];
 
-        uint64_t westCaptures = bitboards[BLACK + PAWN] >> 9 & 0x7f7f7f7f7f7f7f7f;
-        if (westCaptures & oppositionKingBitboard) {
-            attackingPawnMap = (westCaptures & oppositionKingBitboard) << 9;
-        }
-
-        uint64_t eastCaptures = bitboards[BLACK + PAWN] >> 7 & 0xfefefefefefefefe;
-        if (eastCaptures & oppositionKingBitboard) {
-            attackingPawnMap = (eastCaptures & oppositionKingBitboard) << 7;
-        }
-
-        if (attackingPawnMap << 8 & 1ULL << enPassantSquare) {
-            attackingPawnMap |= 1ULL << enPassantSquare;
-        }
-
-        attackMap = westCaptures | eastCaptures;
-    } else {
-        uint64_t oppositionKingBitboard = bitboards[BLACK + KING];
-
-        uint64_t westCaptures = bitboards[WHITE + PAWN] << 7 & 0x7f7f7f7f7f7f7f7f;
-        if (westCaptures & oppositionKingBitboard) {
-            attackingPawnMap = (westCaptures & oppositionKingBitboard) >> 7;
-        }
-
-        uint64_t eastCaptures = bitboards[WHITE + PAWN] << 9 & 0xfefefefefefefefe;
-        if (eastCaptures & oppositionKingBitboard) {
-            attackingPawnMap = (eastCaptures & oppositionKingBitboard) >> 9;
-        }
-
-        if (attackingPawnMap >> 8 & 1ULL << enPassantSquare) {
-            attackingPawnMap |= 1ULL << enPassantSquare;
-        }
+    uint64_t westCaptures = shift<forwardWest<Them>>(position->bitboards[Them + PAWN]) & 0x7f7f7f7f7f7f7f7f;
+    if (westCaptures & oppositionKingBitboard) {
+        attackingPawnMap = shift<-forwardWest<Them>>(westCaptures & oppositionKingBitboard);
+    }
 
-        attackMap = westCaptures | eastCaptures;
+    uint64_t eastCaptures = shift<forwardEast<Them>>(position->bitboards[Them + PAWN]) & 0xfefefefefefefefe;
+    if (eastCaptures & oppositionKingBitboard) {
+        attackingPawnMap = shift<-forwardEast<Them>>(eastCaptures & oppositionKingBitboard);
     }
+
     if (attackingPawnMap) {
         checkEvasionMask = attackingPawnMap;
     }
-    return attackMap;
+    return westCaptures | eastCaptures;
 }
 
-uint64_t Board::generateKnightAttackMaps() {
-    int colourValue = isWhiteTurn ? BLACK : WHITE;
-    uint64_t bitboardCopy = bitboards[colourValue + KNIGHT];
-    uint64_t oppositionKingBitboard = bitboards[8 - colourValue + KING];
+template <Colour Us> uint64_t Board::generateKnightAttackMaps() {
+    constexpr Colour Them = Us == White ? Black : White;
+    uint64_t bitboardCopy = position->bitboards[Them + KNIGHT];
+    uint64_t oppositionKingBitboard = position->bitboards[Us + KING];
 
     uint64_t attackMap = 0;
     while (bitboardCopy) {
@@ -238,23 +389,20 @@ uint64_t Board::generateKnightAttackMaps() {
     return attackMap;
 }
 
-uint64_t Board::generateSlidingAttackMaps() {
-    int colourValue = isWhiteTurn ? BLACK : WHITE;
+template <Colour Us> uint64_t Board::generateSlidingAttackMaps() {
+    constexpr Colour Them = Us == White ? Black : White;
     uint64_t attackMap = 0;
-    uint64_t oppositionKing = bitboards[8 - colourValue + KING];
+    uint64_t oppositionKing = position->bitboards[Us + KING];
+    // The king is removed so squares behind it along an attacking ray count as attacked
+    uint64_t occupancy = (position->bitboards[WHITE] | position->bitboards[BLACK]) & ~oppositionKing;
 
     for (int i = 3; i < 6; i++) {
-        uint64_t bitboardCopy = bitboards[colourValue + i];
+        uint64_t bitboardCopy = position->bitboards[Them + i];
         while (bitboardCopy) {
             int pieceSquare = std::countr_zero(bitboardCopy);
 
             if (i == BISHOP | i == QUEEN) {
-                uint64_t occupancyMask = magics::bishopOccupancyMasks[pieceSquare];
-                uint64_t magic = magics::bishopMagics[pieceSquare];
-                int numBits = magics::bishopNumBits[pieceSquare];
-                int index = ((((bitboards[WHITE] | bitboards[BLACK]) & ~oppositionKing) & occupancyMask) * magic) >>
-                            (64 - numBits);
-                uint64_t possibleMoves = magics::bishopLookupTable[pieceSquare][index];
+                uint64_t possibleMoves = attacks::bishop(pieceSquare, occupancy);
                 attackMap |= possibleMoves;
                 if (possibleMoves & oppositionKing) {
                     numChecks++;
@@ -262,12 +410,7 @@ uint64_t Board::generateSlidingAttackMaps() {
                 }
             }
             if (i == ROOK | i == QUEEN) {
-                uint64_t occupancyMask = magics::rookOccupancyMasks[pieceSquare];
-                uint64_t magic = magics::rookMagics[pieceSquare];
-                int numBits = magics::rookNumBits[pieceSquare];
-                int index = ((((bitboards[WHITE] | bitboards[BLACK]) & ~oppositionKing) & occupancyMask) * magic) >>
-                            (64 - numBits);
-                uint64_t possibleMoves = magics::rookLookupTable[pieceSquare][index];
+                uint64_t possibleMoves = attacks::rook(pieceSquare, occupancy);
                 attackMap |= possibleMoves;
                 if (possibleMoves & oppositionKing) {
                     numChecks++;
@@ -283,30 +426,19 @@ uint64_t Board::generateSlidingAttackMaps() {
 }
 
 void Board::calculateBlockMask(int pieceSquare, int kingSquare, bool isBishop) {
-    uint64_t magic = isBishop ? magics::bishopMagics[pieceSquare] : magics::rookMagics[pieceSquare];
-    uint64_t occupancyMask =
-        isBishop ? magics::bishopOccupancyMasks[pieceSquare] : magics::rookOccupancyMasks[pieceSquare];
-    int numBits = isBishop ? magics::bishopNumBits[pieceSquare] : magics::rookNumBits[pieceSquare];
-
-    int pieceIndex = (((bitboards[WHITE] | bitboards[BLACK]) & occupancyMask) * magic) >> (64 - numBits);
-    uint64_t pieceAttacks = isBishop ? magics::bishopLookupTable[pieceSquare][pieceIndex]
-                                     : magics::rookLookupTable[pieceSquare][pieceIndex];
-
-    magic = isBishop ? magics::bishopMagics[kingSquare] : magics::rookMagics[kingSquare];
-    occupancyMask = isBishop ? magics::bishopOccupancyMasks[kingSquare] : magics::rookOccupancyMasks[kingSquare];
-    numBits = isBishop ? magics::bishopNumBits[kingSquare] : magics::rookNumBits[kingSquare];
-
-    int kingIndex = (((bitboards[WHITE] | bitboards[BLACK]) & occupancyMask) * magic) >> (64 - numBits);
+    uint64_t occupancy = position->bitboards[WHITE] | position->bitboards[BLACK];
+    uint64_t pieceAttacks =
+        isBishop ? attacks::bishop(pieceSquare, occupancy) : attacks::rook(pieceSquare, occupancy);
     uint64_t kingAttacks =
-        isBishop ? magics::bishopLookupTable[kingSquare][kingIndex] : magics::rookLookupTable[kingSquare][kingIndex];
+        isBishop ? attacks::bishop(kingSquare, occupancy) : attacks::rook(kingSquare, occupancy);
 
     checkEvasionMask = pieceAttacks & kingAttacks | 1ULL << pieceSquare;
 }
 
-uint64_t Board::generateKingAttackMaps() {
-    int colourValue = isWhiteTurn ? BLACK : WHITE;
+template <Colour Us> uint64_t Board::generateKingAttackMaps() {
+    constexpr Colour Them = Us == White ? Black : White;
 
-    uint64_t bitboardCopy = bitboards[colourValue + KING];
+    uint64_t bitboardCopy = position->bitboards[Them + KING];
     uint64_t possibleMoves = 0;
     while (bitboardCopy) {
         int pieceSquare = std::countr_zero(bitboardCopy);
@@ -316,20 +448,20 @@ uint64_t Board::generateKingAttackMaps() {
     return possibleMoves;
 }
 
-void Board::calculatePinnedPieces() {
-    int colourValue = isWhiteTurn ? WHITE : BLACK;
-    uint64_t pieceMap = bitboards[WHITE] | bitboards[BLACK];
+template <Colour Us, int Type> void Board::calculatePinnedPieces(MoveList &moveList) {
+    constexpr Colour Them = Us == White ? Black : White;
+    uint64_t pieceMap = position->bitboards[WHITE] | position->bitboards[BLACK];
     pinnedPieces = 0;
 
-    int kingLocation = std::countr_zero(bitboards[colourValue + KING]);
+    int kingLocation = std::countr_zero(position->bitboards[Us + KING]);
     int kingFile = kingLocation & 7;
     int kingRank = kingLocation / 8;
 
     uint64_t kingBishopMask = masks::bishopMoveMasks[kingLocation];
     uint64_t kingRookMask = masks::rookMoveMasks[kingLocation];
     uint64_t pinningPieces =
-        (bitboards[8 - colourValue + BISHOP] | bitboards[8 - colourValue + QUEEN]) & kingBishopMask |
-        (bitboards[8 - colourValue + ROOK] | bitboards[8 - colourValue + QUEEN]) & kingRookMask;
+        ((position->bitboards[Them + BISHOP] | position->bitboards[Them + QUEEN]) & kingBishopMask) |
+        ((position->bitboards[Them + ROOK] | position->bitboards[Them + QUEEN]) & kingRookMask);
     while (pinningPieces) {
         int pieceSquare = std::countr_zero(pinningPieces);
         int pieceFile = pieceSquare & 7;
@@ -353,147 +485,157 @@ void Board::calculatePinnedPieces() {
                 break;
             }
         }
-        uint64_t pinnedPieceBitboard = kingSightMap & pieceSightMap & bitboards[colourValue];
+        uint64_t pinnedPieceBitboard = kingSightMap & pieceSightMap & position->bitboards[Us];
         if (pinnedPieceBitboard) {
             int pinnedPieceSquare = std::countr_zero(pinnedPieceBitboard);
             pinnedPieces |= pinnedPieceBitboard;
             uint64_t possibleMovesRay = (kingSightMap | pieceSightMap) & ~pinnedPieceBitboard & checkEvasionMask;
-            if ((state[pinnedPieceSquare] & 0b111) == PAWN) {
-                addPinnedPawnMoves(pinnedPieceSquare, possibleMovesRay);
+            if (position->bitboards[Us + PAWN] & pinnedPieceBitboard) {
+                addPawnMoves<Us, Type>(moveList, pinnedPieceBitboard, possibleMovesRay);
             } else {
                 bool isDiagonalPin = !(abs(kingOffset) == 1 || abs(kingOffset) == 8);
-                addPinnedPieceMoves(pinnedPieceSquare, possibleMovesRay, isDiagonalPin);
+                addPinnedPieceMoves(moveList, pinnedPieceSquare,
+                                    possibleMovesRay & moveTargets<Us, Type>(position->bitboards), isDiagonalPin);
             }
         }
         pinningPieces &= pinningPieces - 1;
     }
 }
 
-void Board::addPinnedPieceMoves(int pieceSquare, uint64_t pinnedMovesMask, bool isDiagonalPin) {
-    bool diagonalAndBishop = isDiagonalPin && (state[pieceSquare] & 0b111) == BISHOP;
-    bool notDiagonalAndRook = !isDiagonalPin && (state[pieceSquare] & 0b111) == ROOK;
-    bool isQueen = (state[pieceSquare] & 0b111) == QUEEN;
+void Board::addPinnedPieceMoves(MoveList &moveList, int pieceSquare, uint64_t pinnedMovesMask, bool isDiagonalPin) {
+    int pieceType = pieceOn(pieceSquare) & 0b111;
+    bool diagonalAndBishop = isDiagonalPin && pieceType == BISHOP;
+    bool notDiagonalAndRook = !isDiagonalPin && pieceType == ROOK;
+    bool isQueen = pieceType == QUEEN;
     if (diagonalAndBishop || notDiagonalAndRook || isQueen) {
         while (pinnedMovesMask) {
             int destination = std::countr_zero(pinnedMovesMask);
-            if (state[destination]) {
-                moves.push_back(Move(pieceSquare, destination, 4));
+            if (isOccupied(destination)) {
+                moveList.push_back(Move(pieceSquare, destination, 4));
             } else {
-                moves.push_back(Move(pieceSquare, destination, 0));
+                moveList.push_back(Move(pieceSquare, destination, 0));
             }
             pinnedMovesMask &= pinnedMovesMask - 1;
         }
     }
 }
 
-void Board::addPinnedPawnMoves(int pieceSquare, uint64_t pinnedMovesMask) {
-    uint64_t pinnedPawnBitboard = 1ULL << pieceSquare;
-    if (isWhiteTurn) {
-        uint64_t westCaptures = pinnedPawnBitboard << 7 & (bitboards[BLACK] | (1ULL << enPassantSquare)) &
-                                0x7f7f7f7f7f7f7f7f & checkEvasionMask & pinnedMovesMask;
-        addMovesFromBitmap(westCaptures, -7);
-
-        uint64_t eastCaptures = pinnedPawnBitboard << 9 & (bitboards[BLACK] | (1ULL << enPassantSquare)) &
-                                0xfefefefefefefefe & checkEvasionMask & pinnedMovesMask;
-        addMovesFromBitmap(eastCaptures, -9);
-
-        uint64_t forwardMoves =
-            pinnedPawnBitboard << 8 & ~(bitboards[WHITE] | bitboards[BLACK]) & checkEvasionMask & pinnedMovesMask;
-        addMovesFromBitmap(forwardMoves, -8);
+// Moves for the given pawns whose destinations are in destinationMask
+template <Colour Us, int Type> void Board::addPawnMoves(MoveList &moveList, uint64_t pawns, uint64_t destinationMask) {
+    constexpr Colour Them = Us == White ? Black : White;
 
-        uint64_t unmovedPawns = pinnedPawnBitboard & 0xff00;
-        uint64_t freeSquares = ~(bitboards[WHITE] | bitboards[BLACK]);
-        uint64_t doublePawnMoves = (unmovedPawns << 8 & freeSquares) << 8 & (unmovedPawns << 16 & freeSquares) &
-                                   checkEvasionMask & pinnedMovesMask;
-        addMovesFromBitmap(doublePawnMoves, -16);
-    } else {
-        uint64_t westCaptures = pinnedPawnBitboard >> 9 & (bitboards[WHITE] | (1ULL << enPassantSquare)) &
-                                0x7f7f7f7f7f7f7f7f & checkEvasionMask & pinnedMovesMask;
-        addMovesFromBitmap(westCaptures, 9);
+    if constexpr (Type != GENERATE_QUIETS) {
+        uint64_t capturable = position->bitboards[Them];
+        if (position->enPassantSquare != -1) {
+            capturable |= 1ULL << position->enPassantSquare;
+        }
+        uint64_t westCaptures =
+            shift<forwardWest<Us>>(pawns) & capturable & 0x7f7f7f7f7f7f7f7f & destinationMask;
+        addMovesFromBitmap<Us, -forwardWest<Us>>(moveList, westCaptures);
 
-        uint64_t eastCaptures = pinnedPawnBitboard >> 7 & (bitboards[WHITE] | (1ULL << enPassantSquare)) &
-                                0xfefefefefefefefe & checkEvasionMask & pinnedMovesMask;
-        addMovesFromBitmap(eastCaptures, 7);
+        uint64_t eastCaptures =
+            shift<forwardEast<Us>>(pawns) & capturable & 0xfefefefefefefefe & destinationMask;
+        addMovesFromBitmap<Us, -forwardEast<Us>>(moveList, eastCaptures);
+    }
 
-        uint64_t forwardMoves =
-            pinnedPawnBitboard >> 8 & ~(bitboards[WHITE] | bitboards[BLACK]) & checkEvasionMask & pinnedMovesMask;
-        addMovesFromBitmap(forwardMoves, 8);
+    // Pushes onto the last rank are promotions, so they are generated with the captures
+    uint64_t freeSquares = ~(position->bitboards[WHITE] | position->bitboards[BLACK]);
+    uint64_t forwardMoves = shift<forward<Us>>(pawns) & freeSquares & destinationMask;
+    if constexpr (Type == GENERATE_CAPTURES) {
+        forwardMoves &= promotionRank<Us>;
+    } else if constexpr (Type == GENERATE_QUIETS) {
+        forwardMoves &= ~promotionRank<Us>;
+    }
+    addMovesFromBitmap<Us, -forward<Us>>(moveList, forwardMoves);
 
-        uint64_t unmovedPawns = pinnedPawnBitboard & 0xff000000000000;
-        uint64_t freeSquares = ~(bitboards[WHITE] | bitboards[BLACK]);
-        uint64_t doublePawnMoves = (unmovedPawns >> 8 & freeSquares) >> 8 & (unmovedPawns >> 16 & freeSquares) &
-                                   checkEvasionMask & pinnedMovesMask;
-        addMovesFromBitmap(doublePawnMoves, 16);
+    if constexpr (Type != GENERATE_CAPTURES) {
+        uint64_t unmovedPawns = pawns & pawnStartRank<Us>;
+        uint64_t doublePawnMoves = shift<forward<Us>>(shift<forward<Us>>(unmovedPawns) & freeSquares) &
+                                   shift<2 * forward<Us>>(unmovedPawns) & freeSquares & destinationMask;
+        addMovesFromBitmap<Us, -2 * forward<Us>>(moveList, doublePawnMoves);
     }
 }
 
-void Board::generateLegalMoves() {
+template <Colour Us, int Type> void Board::generateLegalMoves(MoveList &moveList) {
+    // The captures and quiets of a position are usually generated separately, so the check status is kept between them
+    if (!isCheckStatusKnown) {
+        determineCheckStatus<Us>();
+        isCheckStatusKnown = true;
+    }
     // If in double check only the king can move so no need to generate other moves
+    calculatePinnedPieces<Us, Type>(moveList);
     if (numChecks < 2) {
-        generatePawnMoves();
-        generateKnightMoves();
-        generateSlidingMoves();
+        // A checking pawn that has just moved two squares can also be captured en passant, but only by a pawn
+        uint64_t pawnDestinations = checkEvasionMask;
+        if (position->enPassantSquare != -1 && checkEvasionMask & 1ULL << (position->enPassantSquare - forward<Us>)) {
+            pawnDestinations |= 1ULL << position->enPassantSquare;
+        }
+        addPawnMoves<Us, Type>(moveList, position->bitboards[Us + PAWN] & ~pinnedPieces, pawnDestinations);
+        generateKnightMoves<Us, Type>(moveList);
+        generateSlidingMoves<Us, Type>(moveList);
     }
-    generateKingMoves();
+    generateKingMoves<Us, Type>(moveList);
 }
 
-void Board::addMovesFromBitmap(uint64_t bitmap, int startSquareOffset) {
+template <Colour Us, int StartSquareOffset> void Board::addMovesFromBitmap(MoveList &moveList, uint64_t bitmap) {
+    constexpr bool isDoublePush = StartSquareOffset == 16 || StartSquareOffset == -16;
+    constexpr bool isCaptureDirection = StartSquareOffset % 8 != 0;
     while (bitmap) {
         int destinationSquare = std::countr_zero(bitmap);
-        int startSquare = destinationSquare + startSquareOffset;
+        int startSquare = destinationSquare + StartSquareOffset;
         unsigned int flags = 0;
-        if (std::abs(startSquareOffset) == 16) {
+        if constexpr (isDoublePush) {
             flags |= 1;
         }
-        if (state[destinationSquare]) {
+        if (isCaptureDirection && isOccupied(destinationSquare)) {
             flags |= 1 << 2;
         }
-        if (destinationSquare == enPassantSquare) {
+        if (isCaptureDirection && destinationSquare == position->enPassantSquare) {
             flags |= 5;
         }
-        if (destinationSquare < 8 || destinationSquare > 55) {
+        if (!isDoublePush && (Us == White ? destinationSquare > 55 : destinationSquare < 8)) {
             // Pawn has been promoted
             flags |= 1 << 3;
             for (int i = 1; i < 4; i++) {
-                moves.push_back(Move(startSquare, destinationSquare, flags | i));
+                moveList.push_back(Move(startSquare, destinationSquare, flags | i));
             }
         }
 
         if (flags == 5) {
-            if (!checkEnPassantPin(startSquare)) {
-                moves.push_back(Move(startSquare, destinationSquare, flags));
+            if (!checkEnPassantPin<Us>(startSquare)) {
+                moveList.push_back(Move(startSquare, destinationSquare, flags));
             }
         } else {
-            moves.push_back(Move(startSquare, destinationSquare, flags));
+            moveList.push_back(Move(startSquare, destinationSquare, flags));
         }
         bitmap &= bitmap - 1;
     }
 }
 
 // Checks the edge case where en passant would reveal an attack on the king.
-bool Board::checkEnPassantPin(int startSquare) {
+template <Colour Us> bool Board::checkEnPassantPin(int startSquare) {
+    constexpr Colour Them = Us == White ? Black : White;
     int rank = startSquare / 8;
     uint64_t rankMask = 0xffULL << (rank * 8);
-    int colourValue = isWhiteTurn ? WHITE : BLACK;
 
-    if (!(rankMask & bitboards[colourValue + KING])) {
+    if (!(rankMask & position->bitboards[Us + KING])) {
         return false;
     }
-    if (!(rankMask & (bitboards[8 - colourValue + ROOK] | bitboards[8 - colourValue + QUEEN]))) {
+    if (!(rankMask & (position->bitboards[Them + ROOK] | position->bitboards[Them + QUEEN]))) {
         return false;
     }
 
-    int offset = isWhiteTurn ? -8 : 8;
-    int capturedPawn = enPassantSquare + offset;
+    int capturedPawn = position->enPassantSquare - forward<Us>;
 
-    uint64_t pawnsRemoved = (bitboards[WHITE] | bitboards[BLACK]) & ~(1ULL << startSquare) & ~(1ULL << capturedPawn);
-    int kingSquare = std::countr_zero(bitboards[colourValue + KING]);
+    uint64_t pawnsRemoved =
+        (position->bitboards[WHITE] | position->bitboards[BLACK]) & ~(1ULL << startSquare) & ~(1ULL << capturedPawn);
+    int kingSquare = std::countr_zero(position->bitboards[Us + KING]);
     int offsets[2] = {-1, 1};
     for (int i = 0; i < 2; i++) {
-        for (int j = 1; i <= masks::numSquaresToEdge[kingSquare][i + 2]; j++) {
+        for (int j = 1; j <= masks::numSquaresToEdge[kingSquare][i + 2]; j++) {
             int square = kingSquare + offsets[i] * j;
             if (pawnsRemoved & 1ULL << square) {
-                if (state[square] == (8 - colourValue + ROOK) || state[square] == (8 - colourValue + QUEEN)) {
+                if ((position->bitboards[Them + ROOK] | position->bitboards[Them + QUEEN]) >> square & 1) {
                     return true;
                 }
                 break;
@@ -503,250 +645,275 @@ bool Board::checkEnPassantPin(int startSquare) {
     return false;
 }
 
-void Board::generatePawnMoves() {
-    if (isWhiteTurn) {
-        uint64_t pawnsWithoutPins = bitboards[WHITE + PAWN] & ~pinnedPieces;
-        uint64_t westCaptures = pawnsWithoutPins << 7 & (bitboards[BLACK] | (1ULL << enPassantSquare)) &
-                                0x7f7f7f7f7f7f7f7f & checkEvasionMask;
-        addMovesFromBitmap(westCaptures, -7);
-
-        uint64_t eastCaptures = pawnsWithoutPins << 9 & (bitboards[BLACK] | (1ULL << enPassantSquare)) &
-                                0xfefefefefefefefe & checkEvasionMask;
-        addMovesFromBitmap(eastCaptures, -9);
-
-        uint64_t forwardMoves = pawnsWithoutPins << 8 & ~(bitboards[WHITE] | bitboards[BLACK]) & checkEvasionMask;
-        addMovesFromBitmap(forwardMoves, -8);
-
-        uint64_t unmovedPawns = pawnsWithoutPins & 0xff00;
-        uint64_t freeSquares = ~(bitboards[WHITE] | bitboards[BLACK]);
-        uint64_t doublePawnMoves =
-            (unmovedPawns << 8 & freeSquares) << 8 & (unmovedPawns << 16 & freeSquares) & checkEvasionMask;
-        addMovesFromBitmap(doublePawnMoves, -16);
-    } else {
-        uint64_t pawnsWithoutPins = bitboards[BLACK + PAWN] & ~pinnedPieces;
-        uint64_t westCaptures = pawnsWithoutPins >> 9 & (bitboards[WHITE] | (1ULL << enPassantSquare)) &
-                                0x7f7f7f7f7f7f7f7f & checkEvasionMask;
-        addMovesFromBitmap(westCaptures, 9);
-
-        uint64_t eastCaptures = pawnsWithoutPins >> 7 & (bitboards[WHITE] | (1ULL << enPassantSquare)) &
-                                0xfefefefefefefefe & checkEvasionMask;
-        addMovesFromBitmap(eastCaptures, 7);
-
-        uint64_t forwardMoves = pawnsWithoutPins >> 8 & ~(bitboards[WHITE] | bitboards[BLACK]) & checkEvasionMask;
-        addMovesFromBitmap(forwardMoves, 8);
-
-        uint64_t unmovedPawns = pawnsWithoutPins & 0xff000000000000;
-        uint64_t freeSquares = ~(bitboards[WHITE] | bitboards[BLACK]);
-        uint64_t doublePawnMoves =
-            (unmovedPawns >> 8 & freeSquares) >> 8 & (unmovedPawns >> 16 & freeSquares) & checkEvasionMask;
-        addMovesFromBitmap(doublePawnMoves, 16);
-    }
-}
-
-void Board::generateKnightMoves() {
-    int colourValue = isWhiteTurn ? WHITE : BLACK;
-    uint64_t bitboardCopy = bitboards[colourValue + KNIGHT] & ~pinnedPieces;
+template <Colour Us, int Type> void Board::generateKnightMoves(MoveList &moveList) {
+    uint64_t targets = moveTargets<Us, Type>(position->bitboards) & checkEvasionMask;
+    uint64_t bitboardCopy = position->bitboards[Us + KNIGHT] & ~pinnedPieces;
     while (bitboardCopy) {
         int pieceSquare = std::countr_zero(bitboardCopy);
-        uint64_t possibleMoves = masks::knightMoveMasks[pieceSquare] & ~bitboards[colourValue] & checkEvasionMask;
+        uint64_t possibleMoves = masks::knightMoveMasks[pieceSquare] & targets;
         while (possibleMoves) {
             int destinationSquare = std::countr_zero(possibleMoves);
             int flags = 0;
-            if (state[destinationSquare]) {
+            if (isOccupied(destinationSquare)) {
                 flags += 1 << 2;
             }
-            moves.push_back(Move(pieceSquare, destinationSquare, flags));
+            moveList.push_back(Move(pieceSquare, destinationSquare, flags));
             possibleMoves &= possibleMoves - 1;
         }
         bitboardCopy &= bitboardCopy - 1;
     }
 }
 
-void Board::addSlidingMoves(uint64_t possibleMoves, int startSquare) {
+void Board::addSlidingMoves(MoveList &moveList, uint64_t possibleMoves, int startSquare) {
     while (possibleMoves) {
         int destinationSquare = std::countr_zero(possibleMoves);
-        if (state[destinationSquare]) {
-            moves.push_back(Move(startSquare, destinationSquare, 4));
+        if (isOccupied(destinationSquare)) {
+            moveList.push_back(Move(startSquare, destinationSquare, 4));
         } else {
-            moves.push_back(Move(startSquare, destinationSquare, 0));
+            moveList.push_back(Move(startSquare, destinationSquare, 0));
         }
         possibleMoves &= possibleMoves - 1;
     }
 }
 
-void Board::generateSlidingMoves() {
-    int colourValue = isWhiteTurn ? WHITE : BLACK;
+template <Colour Us, int Type> void Board::generateSlidingMoves(MoveList &moveList) {
+    uint64_t targets = moveTargets<Us, Type>(position->bitboards) & checkEvasionMask;
     for (int i = 3; i < 6; i++) {
-        uint64_t bitboardCopy = bitboards[colourValue + i] & ~pinnedPieces;
+        uint64_t bitboardCopy = position->bitboards[Us + i] & ~pinnedPieces;
         while (bitboardCopy) {
             int pieceSquare = std::countr_zero(bitboardCopy);
             if (i == BISHOP | i == QUEEN) {
-                uint64_t occupancyMask = magics::bishopOccupancyMasks[pieceSquare];
-                uint64_t magic = magics::bishopMagics[pieceSquare];
-                int numBits = magics::bishopNumBits[pieceSquare];
-                int index = (((bitboards[WHITE] | bitboards[BLACK]) & occupancyMask) * magic) >> (64 - numBits);
                 uint64_t possibleMoves =
-                    magics::bishopLookupTable[pieceSquare][index] & checkEvasionMask & ~bitboards[colourValue];
-                addSlidingMoves(possibleMoves, pieceSquare);
+                    attacks::bishop(pieceSquare, position->bitboards[WHITE] | position->bitboards[BLACK]) & targets;
+                addSlidingMoves(moveList, possibleMoves, pieceSquare);
             }
             if (i == ROOK | i == QUEEN) {
-                uint64_t occupancyMask = magics::rookOccupancyMasks[pieceSquare];
-                uint64_t magic = magics::rookMagics[pieceSquare];
-                int numBits = magics::rookNumBits[pieceSquare];
-                int index = (((bitboards[WHITE] | bitboards[BLACK]) & occupancyMask) * magic) >> (64 - numBits);
                 uint64_t possibleMoves =
-                    magics::rookLookupTable[pieceSquare][index] & checkEvasionMask & ~bitboards[colourValue];
-                addSlidingMoves(possibleMoves, pieceSquare);
+                    attacks::rook(pieceSquare, position->bitboards[WHITE] | position->bitboards[BLACK]) & targets;
+                addSlidingMoves(moveList, possibleMoves, pieceSquare);
             }
             bitboardCopy &= bitboardCopy - 1;
         }
     }
 }
 
-void Board::generateKingMoves() {
-    int colourValue = isWhiteTurn ? WHITE : BLACK;
-    int colourCastlingRights = isWhiteTurn ? castlingRights >> 2 : castlingRights & 3;
-    int kingStartingSquare = isWhiteTurn ? 4 : 60;
+template <Colour Us, int Type> void Board::generateKingMoves(MoveList &moveList) {
+    int colourCastlingRights = Us == White ? position->castlingRights >> 2 : position->castlingRights & 3;
+    constexpr int kingStartingSquare = Us == White ? 4 : 60;
 
-    uint64_t bitboardCopy = bitboards[colourValue + KING];
+    uint64_t bitboardCopy = position->bitboards[Us + KING];
     while (bitboardCopy) {
         int pieceSquare = std::countr_zero(bitboardCopy);
-        if (pieceSquare == kingStartingSquare && !numChecks) {
+        if (Type != GENERATE_CAPTURES && pieceSquare == kingStartingSquare && !numChecks) {
             if (colourCastlingRights & 1) {
                 // Check queenside castling
                 uint64_t queensideCastlingMask = 1ULL << (pieceSquare - 1) | 1ULL << (pieceSquare - 2);
-                if (!(state[pieceSquare - 1] | state[pieceSquare - 2] | state[pieceSquare - 3]) &&
+                if (!isOccupied(pieceSquare - 1) && !isOccupied(pieceSquare - 2) && !isOccupied(pieceSquare - 3) &&
                     !(queensideCastlingMask & opponentAttackMap)) {
-                    moves.push_back(Move(pieceSquare, pieceSquare - 2, 3));
+                    moveList.push_back(Move(pieceSquare, pieceSquare - 2, 3));
                 }
             }
             if (colourCastlingRights & 2) {
                 // Check kingside castling
                 uint64_t kingsideCastlingMask = 1ULL << (pieceSquare + 1) | 1ULL << (pieceSquare + 2);
-                if (!(state[pieceSquare + 1] | state[pieceSquare + 2]) && !(kingsideCastlingMask & opponentAttackMap)) {
-                    moves.push_back(Move(pieceSquare, pieceSquare + 2, 2));
+                if (!isOccupied(pieceSquare + 1) && !isOccupied(pieceSquare + 2) &&
+                    !(kingsideCastlingMask & opponentAttackMap)) {
+                    moveList.push_back(Move(pieceSquare, pieceSquare + 2, 2));
                 }
             }
         }
-        uint64_t possibleMoves = masks::kingMoveMasks[pieceSquare] & ~bitboards[colourValue] & ~opponentAttackMap;
+        uint64_t possibleMoves =
+            masks::kingMoveMasks[pieceSquare] & moveTargets<Us, Type>(position->bitboards) & ~opponentAttackMap;
         while (possibleMoves) {
             int destinationSquare = std::countr_zero(possibleMoves);
             int flags = 0;
-            if (state[destinationSquare]) {
+            if (isOccupied(destinationSquare)) {
                 flags += 1 << 2;
             }
-            moves.push_back(Move(pieceSquare, destinationSquare, flags));
+            moveList.push_back(Move(pieceSquare, destinationSquare, flags));
             possibleMoves &= possibleMoves - 1;
         }
         bitboardCopy &= bitboardCopy - 1;
     }
 }
 
+/* Checks a quiet move without generating the quiet moves: the piece on the start square has to be able to make it, and
+ * it must not leave the king attacked. Castling also needs the right, empty squares and a king that doesn't pass
+ * through check. */
+template <Colour Us> bool Board::isLegalQuiet(Move move) {
+    constexpr Colour Them = Us == White ? Black : White;
+    int start = move.getStart();
+    int destination = move.getDestination();
+    unsigned int flags = move.getFlags();
+    int piece = pieceOn(start) - Us;
+    if (flags > 3 || start == destination || piece < PAWN || piece > KING || isOccupied(destination)) {
+        return false;
+    }
+
+    uint64_t occupancy = position->bitboards[WHITE] | position->bitboards[BLACK];
+    uint64_t destinationBitboard = 1ULL << destination;
+    uint64_t reachable = 0;
+    switch (piece) {
+    case PAWN:
+        if (destinationBitboard & promotionRank<Us>) {
+            return false;
+        }
+        if (flags == 0) {
+            reachable = 1ULL << (start + forward<Us>);
+        } else if (flags == 1 && 1ULL << start & pawnStartRank<Us> && !isOccupied(start + forward<Us>)) {
+            reachable = 1ULL << (start + 2 * forward<Us>);
+        }
+        break;
+    case KNIGHT:
+        reachable = flags ? 0 : masks::knightMoveMasks[start];
+        break;
+    case BISHOP:
+        reachable = flags ? 0 : attacks::bishop(start, occupancy);
+        break;
+    case ROOK:
+        reachable = flags ? 0 : attacks::rook(start, occupancy);
+        break;
+    case QUEEN:
+        reachable = flags ? 0 : attacks::bishop(start, occupancy) | attacks::rook(start, occupancy);
+        break;
+    case KING:
+        if (flags == 2 || flags == 3) {
+            constexpr int kingStartingSquare = Us == White ? 4 : 60;
+            int colourCastlingRights = Us == White ? position->castlingRights >> 2 : position->castlingRights & 3;
+            bool isKingside = flags == 2;
+            int direction = isKingside ? 1 : -1;
+            int rookSquare = isKingside ? start + 3 : start - 4;
+            if (start != kingStartingSquare || destination != start + 2 * direction ||
+                !(colourCastlingRights & (isKingside ? 2 : 1)) || !(position->bitboards[Us + ROOK] >> rookSquare & 1) ||
+                isOccupied(start + direction) || (!isKingside && isOccupied(start - 3))) {
+                return false;
+            }
+            for (int square = start; square != destination + direction; square += direction) {
+                if (attackersTo(square, occupancy) & position->bitboards[Them]) {
+                    return false;
+                }
+            }
+            return true;
+        }
+        reachable = flags ? 0 : masks::kingMoveMasks[start];
+        break;
+    }
+    if (!(reachable & destinationBitboard)) {
+        return false;
+    }
+
+    // Quiet moves don't remove an opposing piece, so only the moved piece changes what attacks the king
+    occupancy ^= 1ULL << start | destinationBitboard;
+    int kingSquare = piece == KING ? destination : std::countr_zero(position->bitboards[Us + KING]);
+    return !(attackersTo(kingSquare, occupancy) & position->bitboards[Them]);
+}
+
 void Board::makeMove(Move move) {
+    if (position->isWhiteTurn) {
+        makeMove<White>(move);
+    } else {
+        makeMove<Black>(move);
+    }
+}
+
+template <Colour Us> void Board::makeMove(Move move) {
+    constexpr Colour Them = Us == White ? Black : White;
+    // Zobrist key index of this side's rooks, for castling
+    constexpr int rookKey = (Us + ROOK - 1 - (Us / 8) * 2) * 64;
     short start = move.getStart();
     short destination = move.getDestination();
     short flags = move.getFlags();
-    short pieceTaken = -1;
-    short oldHalfMoves = halfMoves;
-
-    zobristHashes.push_back(currentPositionHash);
-    currentPositionHash ^= magics::zobristKeys[768];
 
-    if (enPassantSquare != -1) {
-        int enPassantFile = enPassantSquare & 7;
-        currentPositionHash ^= magics::zobristKeys[785 + enPassantFile];
+    // Copy the position into the next slot of the history stack, growing it for long games
+    if (ply + 1 == (int)history.size()) {
+        history.push_back(history[ply]);
+    } else {
+        history[ply + 1] = history[ply];
     }
-
-    int newCastlingRights = castlingRights;
     ply++;
-    halfMoves++;
-    if (state[start] == WHITE + PAWN || state[start] == BLACK + PAWN) {
-        halfMoves = 0;
+    position = &history[ply];
+
+    position->hash ^= magics::zobristKeys[768];
+
+    if (position->enPassantSquare != -1) {
+        int enPassantFile = position->enPassantSquare & 7;
+        position->hash ^= magics::zobristKeys[785 + enPassantFile];
     }
 
-    if (!isWhiteTurn) {
-        fullMoves++;
+    int newCastlingRights = position->castlingRights;
+    position->halfMoves++;
+    if (position->bitboards[Us + PAWN] >> start & 1) {
+        position->halfMoves = 0;
     }
 
-    int colourValue = isWhiteTurn ? WHITE : BLACK;
+    if constexpr (Us == Black) {
+        position->fullMoves++;
+    }
 
     if (move.isCapture()) {
-        halfMoves = 0;
-        // Check if en passant or normal capture
-        if (flags == 5) {
-            int offset = isWhiteTurn ? -8 : 8;
-            pieceTaken = state[destination + offset];
-            currentPositionHash ^=
-                magics::zobristKeys[(pieceTaken - 1 - (pieceTaken / 8) * 2) * 64 + destination + offset];
-            bitboards[pieceTaken] -= 1ULL << (destination + offset);
-            bitboards[8 - colourValue] -= 1ULL << (destination + offset);
-            state[destination + offset] = 0;
-        } else {
-            pieceTaken = state[destination];
-            currentPositionHash ^= magics::zobristKeys[(pieceTaken - 1 - (pieceTaken / 8) * 2) * 64 + destination];
-            bitboards[pieceTaken] -= 1ULL << destination;
-            bitboards[8 - colourValue] -= 1ULL << destination;
-        }
+        position->halfMoves = 0;
+        // En passant captures the pawn behind the destination square
+        int capturedSquare = flags == 5 ? destination - forward<Us> : destination;
+        int pieceTaken = flags == 5 ? Them + PAWN : pieceOn(capturedSquare);
+        position->hash ^= magics::zobristKeys[(pieceTaken - 1 - (pieceTaken / 8) * 2) * 64 + capturedSquare];
+        position->bitboards[pieceTaken] -= 1ULL << capturedSquare;
+        position->bitboards[Them] -= 1ULL << capturedSquare;
+        updateScores(pieceTaken, capturedSquare, -1);
     }
 
-    gameHistory.push_back(BoardData(castlingRights, enPassantSquare, oldHalfMoves, pieceTaken));
-
     // Double pawn push
     if (flags == 1) {
-        int offset = isWhiteTurn ? -8 : 8;
-        enPassantSquare = destination + offset;
-        int enPassantFile = enPassantSquare & 7;
-        currentPositionHash ^= magics::zobristKeys[785 + enPassantFile];
+        position->enPassantSquare = destination - forward<Us>;
+        int enPassantFile = position->enPassantSquare & 7;
+        position->hash ^= magics::zobristKeys[785 + enPassantFile];
     } else {
-        enPassantSquare = -1;
+        position->enPassantSquare = -1;
     }
 
     // Kingside castle
     if (flags == 2) {
-        newCastlingRights = isWhiteTurn ? newCastlingRights &= 3 : newCastlingRights &= 12;
-        bitboards[colourValue + ROOK] -= 1ULL << (start + 3);
-        bitboards[colourValue + ROOK] += 1ULL << (start + 1);
-        bitboards[colourValue] -= 1ULL << (start + 3);
-        bitboards[colourValue] += 1ULL << (start + 1);
-        state[start + 3] = 0;
-        state[start + 1] = colourValue + ROOK;
-        currentPositionHash ^= (magics::zobristKeys[(colourValue + ROOK - 1 - (colourValue / 8) * 2) * 64 + start + 3] ^
-                                magics::zobristKeys[(colourValue + ROOK - 1 - (colourValue / 8) * 2) * 64 + start + 1]);
+        newCastlingRights &= Us == White ? 3 : 12;
+        position->bitboards[Us + ROOK] -= 1ULL << (start + 3);
+        position->bitboards[Us + ROOK] += 1ULL << (start + 1);
+        position->bitboards[Us] -= 1ULL << (start + 3);
+        position->bitboards[Us] += 1ULL << (start + 1);
+        updateScores(Us + ROOK, start + 3, -1);
+        updateScores(Us + ROOK, start + 1, 1);
+        position->hash ^= magics::zobristKeys[rookKey + start + 3] ^ magics::zobristKeys[rookKey + start + 1];
     }
 
     // Queenside castle
     if (flags == 3) {
-        newCastlingRights = isWhiteTurn ? newCastlingRights &= 3 : newCastlingRights &= 12;
-        bitboards[colourValue + ROOK] -= 1ULL << (start - 4);
-        bitboards[colourValue + ROOK] += 1ULL << (start - 1);
-        bitboards[colourValue] -= 1ULL << (start - 4);
-        bitboards[colourValue] += 1ULL << (start - 1);
-        state[start - 4] = 0;
-        state[start - 1] = colourValue + ROOK;
-        currentPositionHash ^= (magics::zobristKeys[(colourValue + ROOK - 1 - (colourValue / 8) * 2) * 64 + start - 4] ^
-                                magics::zobristKeys[(colourValue + ROOK - 1 - (colourValue / 8) * 2) * 64 + start - 1]);
-    }
-
-    int pieceMoved = state[start];
-    bitboards[pieceMoved] -= 1ULL << start;
-    bitboards[colourValue] -= 1ULL << start;
-    bitboards[colourValue] += 1ULL << destination;
-    state[start] = 0;
-    currentPositionHash ^= magics::zobristKeys[(pieceMoved - 1 - (pieceMoved / 8) * 2) * 64 + start];
+        newCastlingRights &= Us == White ? 3 : 12;
+        position->bitboards[Us + ROOK] -= 1ULL << (start - 4);
+        position->bitboards[Us + ROOK] += 1ULL << (start - 1);
+        position->bitboards[Us] -= 1ULL << (start - 4);
+        position->bitboards[Us] += 1ULL << (start - 1);
+        updateScores(Us + ROOK, start - 4, -1);
+        updateScores(Us + ROOK, start - 1, 1);
+        position->hash ^= magics::zobristKeys[rookKey + start - 4] ^ magics::zobristKeys[rookKey + start - 1];
+    }
+
+    int pieceMoved = pieceOn(start);
+    position->bitboards[pieceMoved] -= 1ULL << start;
+    position->bitboards[Us] -= 1ULL << start;
+    position->bitboards[Us] += 1ULL << destination;
+    position->hash ^= magics::zobristKeys[(pieceMoved - 1 - (pieceMoved / 8) * 2) * 64 + start];
+    updateScores(pieceMoved, start, -1);
 
     if (move.isPromotion()) {
-        int newPiece = (flags & 3) + colourValue + 2;
-        bitboards[newPiece] += 1ULL << destination;
-        state[destination] = newPiece;
-        currentPositionHash ^= magics::zobristKeys[(newPiece - 1 - (newPiece / 8) * 2) * 64 + destination];
+        int newPiece = (flags & 3) + Us + 2;
+        position->bitboards[newPiece] += 1ULL << destination;
+        position->hash ^= magics::zobristKeys[(newPiece - 1 - (newPiece / 8) * 2) * 64 + destination];
+        updateScores(newPiece, destination, 1);
     } else {
-        bitboards[pieceMoved] += 1ULL << destination;
-        state[destination] = pieceMoved;
-        currentPositionHash ^= magics::zobristKeys[(pieceMoved - 1 - (pieceMoved / 8) * 2) * 64 + destination];
+        position->bitboards[pieceMoved] += 1ULL << destination;
+        position->hash ^= magics::zobristKeys[(pieceMoved - 1 - (pieceMoved / 8) * 2) * 64 + destination];
+        updateScores(pieceMoved, destination, 1);
     }
 
     // Update castling rights
-    if (isWhiteTurn) {
+    if constexpr (Us == White) {
         if (start == 0) {
             newCastlingRights &= 11;
         } else if (start == 4) {
@@ -772,99 +939,166 @@ void Board::makeMove(Move move) {
         }
     }
 
-    if (newCastlingRights != castlingRights) {
-        currentPositionHash ^= magics::zobristKeys[769 + castlingRights];
-        currentPositionHash ^= magics::zobristKeys[769 + newCastlingRights];
-        castlingRights = newCastlingRights;
-    }
-
-    if (!halfMoves) {
-        repetitionStart = ply;
+    if (newCastlingRights != position->castlingRights) {
+        position->hash ^= magics::zobristKeys[769 + position->castlingRights];
+        position->hash ^= magics::zobristKeys[769 + newCastlingRights];
+        position->castlingRights = newCastlingRights;
     }
 
-    isWhiteTurn = !isWhiteTurn;
-
-    moves.clear();
-    setup();
+    position->isWhiteTurn = Us == Black;
+    repetitionFilter[position->hash % REPETITION_FILTER_SIZE]++;
+    isSetUp = false;
+    isCheckStatusKnown = false;
 }
 
-void Board::unmakeMove(Move move) {
-    short start = move.getStart();
-    short destination = move.getDestination();
-    short flags = move.getFlags();
+// The previous position is still in the history stack, so unmaking a move only has to step back to it
+void Board::unmakeMove() {
+    repetitionFilter[position->hash % REPETITION_FILTER_SIZE]--;
+    ply--;
+    position = &history[ply];
+    isSetUp = false;
+    isCheckStatusKnown = false;
+}
 
-    short colourValue = isWhiteTurn ? BLACK : WHITE;
+/* Passes the turn without moving, for null move pruning. The half move clock is reset so that repetition detection
+ * doesn't look past the null move, as positions before it were reached by a different sequence of real moves. */
+void Board::makeNullMove() {
+    if (ply + 1 == (int)history.size()) {
+        history.push_back(history[ply]);
+    } else {
+        history[ply + 1] = history[ply];
+    }
+    ply++;
+    position = &history[ply];
 
-    currentPositionHash = zobristHashes.back();
-    zobristHashes.pop_back();
-    ply--;
-    if (isWhiteTurn) {
-        fullMoves--;
+    position->hash ^= magics::zobristKeys[768];
+    if (position->enPassantSquare != -1) {
+        position->hash ^= magics::zobristKeys[785 + (position->enPassantSquare & 7)];
+        position->enPassantSquare = -1;
     }
+    position->halfMoves = 0;
+    position->isWhiteTurn = !position->isWhiteTurn;
+    repetitionFilter[position->hash % REPETITION_FILTER_SIZE]++;
+    isSetUp = false;
+    isCheckStatusKnown = false;
+}
+
+// Whether the side to move has a piece other than pawns and its king, without which passing is often the best move
+bool Board::hasNonPawnMaterial() {
+    int us = position->isWhiteTurn ? WHITE : BLACK;
+    return position->bitboards[us] & ~(position->bitboards[us + PAWN] | position->bitboards[us + KING]);
+}
 
-    castlingRights = gameHistory.back().castlingRights;
-    enPassantSquare = gameHistory.back().enPassantSquare;
-    halfMoves = gameHistory.back().halfMoves;
+// Pieces of both colours that attack a square, with sliders seen through the given occupancy
+uint64_t Board::attackersTo(int square, uint64_t occupancy) {
+    const std::array<uint64_t, 15> &bitboards = position->bitboards;
+    uint64_t squareBitboard = 1ULL << square;
+    // A pawn attacks the square from where an opposing pawn on the square would capture
+    uint64_t whitePawnAttackers = (shift<forwardWest<Black>>(squareBitboard) & 0x7f7f7f7f7f7f7f7f) |
+                                  (shift<forwardEast<Black>>(squareBitboard) & 0xfefefefefefefefe);
+    uint64_t blackPawnAttackers = (shift<forwardWest<White>>(squareBitboard) & 0x7f7f7f7f7f7f7f7f) |
+                                  (shift<forwardEast<White>>(squareBitboard) & 0xfefefefefefefefe);
+    uint64_t diagonalSliders = bitboards[WHITE + BISHOP] | bitboards[WHITE + QUEEN] | bitboards[BLACK + BISHOP] |
+                               bitboards[BLACK + QUEEN];
+    uint64_t orthogonalSliders =
+        bitboards[WHITE + ROOK] | bitboards[WHITE + QUEEN] | bitboards[BLACK + ROOK] | bitboards[BLACK + QUEEN];
+
+    return (whitePawnAttackers & bitboards[WHITE + PAWN]) | (blackPawnAttackers & bitboards[BLACK + PAWN]) |
+           (masks::knightMoveMasks[square] & (bitboards[WHITE + KNIGHT] | bitboards[BLACK + KNIGHT])) |
+           (masks::kingMoveMasks[square] & (bitboards[WHITE + KING] | bitboards[BLACK + KING])) |
+           (attacks::bishop(square, occupancy) & diagonalSliders) |
+           (attacks::rook(square, occupancy) & orthogonalSliders);
+}
 
+// Material won by a move before either side recaptures, and the piece left standing on the destination square
+static void initialExchange(Board &board, Move move, int &gain, int &pieceOnSquare) {
+    unsigned int flags = move.getFlags();
+    pieceOnSquare = board.getPiece(move.getStart()) & 7;
+    gain = 0;
+    if (flags == 5) {
+        gain = evaluate::pieceValues[PAWN - 1];
+    } else if (move.isCapture()) {
+        gain = evaluate::pieceValues[(board.getPiece(move.getDestination()) & 7) - 1];
+    }
     if (move.isPromotion()) {
-        short promotionPiece = state[destination];
-        bitboards[promotionPiece] -= 1ULL << destination;
-        bitboards[colourValue + PAWN] += 1ULL << start;
-        state[start] = colourValue + PAWN;
-    } else {
-        short pieceMoved = state[destination];
-        bitboards[pieceMoved] -= 1ULL << destination;
-        bitboards[pieceMoved] += 1ULL << start;
-        state[start] = pieceMoved;
+        pieceOnSquare = (flags & 3) + KNIGHT;
+        gain += evaluate::pieceValues[pieceOnSquare - 1] - evaluate::pieceValues[PAWN - 1];
+    }
+}
+
+/* Static exchange evaluation: the material balance once both sides have finished recapturing on the destination
+ * square, each with its least valuable attacker and free to stop when recapturing would lose material. */
+int Board::see(Move move) {
+    unsigned int flags = move.getFlags();
+    if (flags == 2 || flags == 3) {
+        return 0;
     }
 
-    bitboards[colourValue] -= 1ULL << destination;
-    bitboards[colourValue] += 1ULL << start;
-    state[destination] = 0;
+    int destination = move.getDestination();
+    std::array<int, 32> gains;
+    int pieceOnSquare;
+    initialExchange(*this, move, gains[0], pieceOnSquare);
 
-    if (move.isCapture()) {
-        // Check if en passant or normal capture
-        if (flags == 5) {
-            int offset = isWhiteTurn ? 8 : -8;
-            int pieceTaken = gameHistory.back().capturedPiece;
-            bitboards[pieceTaken] += 1ULL << (destination + offset);
-            bitboards[8 - colourValue] += 1ULL << (destination + offset);
-            state[destination + offset] = pieceTaken;
-        } else {
-            int pieceTaken = gameHistory.back().capturedPiece;
-            bitboards[pieceTaken] += 1ULL << destination;
-            bitboards[8 - colourValue] += 1ULL << destination;
-            state[destination] = pieceTaken;
+    uint64_t occupancy = (position->bitboards[WHITE] | position->bitboards[BLACK]) ^ 1ULL << move.getStart();
+    if (flags == 5) {
+        occupancy ^= 1ULL << (destination + (position->isWhiteTurn ? -8 : 8));
+    }
+    uint64_t attackers = attackersTo(destination, occupancy) & occupancy;
+    uint64_t diagonalSliders = position->bitboards[WHITE + BISHOP] | position->bitboards[WHITE + QUEEN] |
+                               position->bitboards[BLACK + BISHOP] | position->bitboards[BLACK + QUEEN];
+    uint64_t orthogonalSliders = position->bitboards[WHITE + ROOK] | position->bitboards[WHITE + QUEEN] |
+                                 position->bitboards[BLACK + ROOK] | position->bitboards[BLACK + QUEEN];
+    int side = position->isWhiteTurn ? BLACK : WHITE;
+
+    int depth = 0;
+    while (uint64_t sideAttackers = attackers & position->bitboards[side]) {
+        int piece = PAWN;
+        while (!(sideAttackers & position->bitboards[side + piece])) {
+            piece++;
         }
+        depth++;
+        // Gain for the side recapturing if the other side then stops
+        gains[depth] = evaluate::pieceValues[pieceOnSquare - 1] - gains[depth - 1];
+
+        uint64_t attacker = sideAttackers & position->bitboards[side + piece];
+        occupancy ^= attacker & -attacker;
+        // Removing the attacker can uncover a slider behind it
+        attackers |= (attacks::bishop(destination, occupancy) & diagonalSliders) |
+                     (attacks::rook(destination, occupancy) & orthogonalSliders);
+        attackers &= occupancy;
+        pieceOnSquare = piece;
+        side ^= BLACK;
     }
 
-    // Kingside castle
-    if (flags == 2) {
-        bitboards[colourValue + ROOK] += 1ULL << (start + 3);
-        bitboards[colourValue + ROOK] -= 1ULL << (start + 1);
-        bitboards[colourValue] += 1ULL << (start + 3);
-        bitboards[colourValue] -= 1ULL << (start + 1);
-        state[start + 1] = 0;
-        state[start + 3] = colourValue + ROOK;
+    // Each side only recaptures when that is better for it than stopping
+    while (depth) {
+        depth--;
+        gains[depth] = -std::max(-gains[depth], gains[depth + 1]);
     }
+    return gains[0];
+}
 
-    // Queenside castle
-    if (flags == 3) {
-        bitboards[colourValue + ROOK] += 1ULL << (start - 4);
-        bitboards[colourValue + ROOK] -= 1ULL << (start - 1);
-        bitboards[colourValue] += 1ULL << (start - 4);
-        bitboards[colourValue] -= 1ULL << (start - 1);
-        state[start - 1] = 0;
-        state[start - 4] = colourValue + ROOK;
+bool Board::seeGE(Move move, int threshold) {
+    unsigned int flags = move.getFlags();
+    if (flags == 2 || flags == 3) {
+        return threshold <= 0;
     }
 
-    repetitionStart = std::max(ply - halfMoves, 0);
-    isWhiteTurn = !isWhiteTurn;
-
-    gameHistory.pop_back();
+    // The exchange can't win more than the first capture, and losing the moving piece is the worst a recapture does
+    int gain;
+    int pieceOnSquare;
+    initialExchange(*this, move, gain, pieceOnSquare);
+    if (gain < threshold) {
+        return false;
+    }
+    if (gain - evaluate::pieceValues[pieceOnSquare - 1] >= threshold) {
+        return true;
+    }
+    return see(move) >= threshold;
 }
 
 std::set<int> Board::getMoveOptions(int startSquare) {
+    ensureSetUp();
     std::set<int> moveOptions;
     for (Move move : moves) {
         if (move.getStart() == startSquare) {
@@ -881,7 +1115,7 @@ void Board::printBoard() {
 
     for (int rank = 7; rank >= 0; rank--) {
         for (int file = 0; file < 8; file++) {
-            int num = state[rank * 8 + file];
+            int num = pieceOn(rank * 8 + file);
             char c = pieceNumToPieceLetter.at(num % 8);
 
             if (num < 8) {
@@ -906,6 +1140,7 @@ void Board::printBitboard(uint64_t bitboard) {
 }
 
 void Board::printMoves() {
+    ensureSetUp();
     for (Move move : moves) {
         std::cout << move.getFlags() << ", " << move.getStart() << ", " << move.getDestination() << '\n';
     }
@@ -5,17 +5,25 @@
 #include <cstdint>
 #include <iostream>
 #include <set>
+#include <string>
+#include <type_traits>
 #include <vector>
 
+#define MAX_MOVES 256
+
 class Move {
   public:
+    Move() = default;
     Move(unsigned int start, unsigned int destination, unsigned int flags);
+    explicit Move(uint16_t value);
 
-    unsigned int getStart();
-    unsigned int getDestination();
-    unsigned int isCapture();
-    unsigned int isPromotion();
-    unsigned int getFlags();
+    unsigned int getStart() const;
+    unsigned int getDestination() const;
+    unsigned int isCapture() const;
+    unsigned int isPromotion() const;
+    unsigned int getFlags() const;
+    uint16_t getValue() const;
+    std::string toString() const;
 
     auto operator<=>(const Move &other) const = default;
 
@@ -23,36 +31,46 @@ class Move {
     unsigned int move;
 };
 
-struct BoardData {
-    short castlingRights;
-    short enPassantSquare;
-    short halfMoves;
-    short capturedPiece;
-};
-
-class Board {
+// Fixed capacity move list that lives on the stack, with a score slot per move for move ordering.
+class MoveList {
   public:
-    Board(std::string startingPos);
+    MoveList() : count(0) {}
 
-    void makeMove(Move move);
-    void unmakeMove(Move move);
+    void push_back(Move move) { moves[count++] = move; }
+    void clear() { count = 0; }
+    int size() const { return count; }
+    bool empty() const { return count == 0; }
 
-    std::set<int> getMoveOptions(int startSquare);
-    std::array<short, 64> getState();
-    std::vector<Move> getMoves();
-    uint64_t getBitboard(int index);
-    short getEnPassantSquare();
-    bool getIsWhiteTurn();
-    uint64_t getOpponentAttackMap();
-    short getGameStatus();
+    Move &operator[](int index) { return moves[index]; }
+    const Move &operator[](int index) const { return moves[index]; }
+    int &score(int index) { return scores[index]; }
 
-    void printBoard();
-    void printBitboard(uint64_t bitboard);
-    void printMoves();
+    Move *begin() { return moves.data(); }
+    Move *end() { return moves.data() + count; }
+    const Move *begin() const { return moves.data(); }
+    const Move *end() const { return moves.data() + count; }
 
   private:
-    std::array<short, 64> state = {0};
+    std::array<Move, MAX_MOVES> moves;
+    std::array<int, MAX_MOVES> scores;
+    int count;
+};
+
+// Side to move, valued as the offset of that colour's bitboards so piece indexes can be formed as colour + piece.
+enum Colour { White = 0, Black = 8 };
 
+#define INITIAL_HISTORY_SIZE 256
+#define REPETITION_FILTER_SIZE 1024
+
+// Which legal moves a generator produces. Captures include every promotion so quiet moves never change material.
+#define GENERATE_ALL 0
+#define GENERATE_CAPTURES 1
+#define GENERATE_QUIETS 2
+
+/* Everything that changes when a move is made. It is trivially copyable, so making a move copies it into the next
+ * slot of the board's history stack and unmaking a move steps back to the previous slot. There is no mailbox, as the
+ * piece on a square can be found from the bitboards, which keeps the copy per move small. */
+struct Position {
     /* Bitboard indexes are:
      *  0 - White pieces
      *  1 - White pawns
@@ -68,54 +86,121 @@ class Board {
      * 11 - Black bishops
      * 12 - Black rooks
      * 13 - Black queens
-     * 14 - Black king
-     * 15 - empty */
-    std::array<uint64_t, 15> bitboards = {0};
-
-    bool isWhiteTurn;
-    short castlingRights;
-    short enPassantSquare;
+     * 14 - Black king */
+    std::array<uint64_t, 15> bitboards;
+    uint64_t hash;
+    // Incrementally updated material and piece-square evaluation terms
+    int midgameScore;
+    int endgameScore;
     short halfMoves;
     short fullMoves;
-    short ply;
-    short repetitionStart;
-    std::vector<uint64_t> zobristHashes;
-    std::vector<Move> moves;
+    int8_t enPassantSquare;
+    uint8_t castlingRights;
+    uint8_t phase;
+    bool isWhiteTurn;
+};
+
+static_assert(std::is_trivially_copyable_v<Position>);
+static_assert(sizeof(Position) <= 160);
+
+class Board {
+  public:
+    Board(std::string startingPos);
+    Board(const Board &other);
+    Board &operator=(const Board &other);
+
+    void makeMove(Move move);
+    void unmakeMove();
+    // Undone with unmakeMove like any other move
+    void makeNullMove();
+
+    std::set<int> getMoveOptions(int startSquare);
+    std::array<uint8_t, 64> getState();
+    short getPiece(int square);
+    const MoveList &getMoves();
+    void generateMoves(MoveList &moveList);
+    void generateCaptures(MoveList &moveList);
+    void generateQuiets(MoveList &moveList);
+    uint64_t getBitboard(int index);
+    uint64_t getHash();
+    int getMidgameScore();
+    int getEndgameScore();
+    int getPhase();
+    short getEnPassantSquare();
+    bool getIsWhiteTurn();
+    uint64_t getOpponentAttackMap();
+    short getGameStatus();
+    bool isInCheck();
+    // Whether a quiet move from another position, such as a killer move, is legal here
+    bool isLegalQuiet(Move move);
+    bool isDraw(int searchPly = 0);
+    bool hasNonPawnMaterial();
+    uint64_t attackersTo(int square, uint64_t occupancy);
+    int see(Move move);
+    bool seeGE(Move move, int threshold);
+
+    void printBoard();
+    void printBitboard(uint64_t bitboard);
+    void printMoves();
+
+  private:
+    // Positions since the start of the game, with the current one at index ply and scratch slots after it
+    std::vector<Position> history;
+    Position *position;
+    int ply;
+    /* Number of positions in the history up to ply whose hash falls in each bucket. A position can only repeat when
+     * its bucket holds another one, which rules out most positions without scanning the history. Byte counts keep board
+     * copies small; a bucket would need 256 positions of one game to wrap. */
+    std::array<uint8_t, REPETITION_FILTER_SIZE> repetitionFilter;
+
+    // Legal moves of the current position, generated on demand by setup() and not copied with the board
+    MoveList moves;
     /* 0 = game not ended
      * 1 = checkmate
      * 2 = draw */
     short gameStatus;
 
     short numChecks;
-    uint64_t currentPositionHash;
     uint64_t opponentAttackMap;
     uint64_t checkEvasionMask;
     uint64_t pinnedPieces;
 
+    bool isSetUp;
+    bool isCheckStatusKnown;
+
     void convertFromFen(std::string fenString);
+    void ensureSetUp();
     void setup();
     uint64_t zobrist();
-    std::vector<BoardData> gameHistory;
-
-    void determineCheckStatus();
-    uint64_t generatePawnAttackMaps();
-    uint64_t generateKnightAttackMaps();
-    uint64_t generateSlidingAttackMaps();
+    void calculateScores();
+    void updateScores(int piece, int square, int sign);
+    int pieceOn(int square);
+    bool isOccupied(int square);
+
+    /* Check detection, move generation and make/unmake are specialised on the side to move, so the public functions
+     * branch on isWhiteTurn once and the shifts, masks and piece indexes below are constants. The generators are also
+     * specialised on which moves they produce. */
+    template <Colour Us> void determineCheckStatus();
+    template <Colour Us> uint64_t generatePawnAttackMaps();
+    template <Colour Us> uint64_t generateKnightAttackMaps();
+    template <Colour Us> uint64_t generateSlidingAttackMaps();
     void calculateBlockMask(int pieceSquare, int kingSquare, bool isBishop);
-    uint64_t generateKingAttackMaps();
-
-    void calculatePinnedPieces();
-    void addPinnedPieceMoves(int pieceSquare, uint64_t pinnedMovesMask, bool isDiagonalPin);
-    void addPinnedPawnMoves(int pieceSquare, uint64_t pinnedMovesMask);
-    bool checkEnPassantPin(int startSquare);
-
-    void generateLegalMoves();
-    void generatePawnMoves();
-    void generateKnightMoves();
-    void addSlidingMoves(uint64_t possibleMoves, int startSquare);
-    void generateSlidingMoves();
-    void generateKingMoves();
-    void addMovesFromBitmap(uint64_t bitmap, int startSquareOffset);
+    template <Colour Us> uint64_t generateKingAttackMaps();
+
+    template <Colour Us, int Type> void calculatePinnedPieces(MoveList &moveList);
+    void addPinnedPieceMoves(MoveList &moveList, int pieceSquare, uint64_t pinnedMovesMask, bool isDiagonalPin);
+    template <Colour Us, int Type> void addPawnMoves(MoveList &moveList, uint64_t pawns, uint64_t destinationMask);
+    template <Colour Us> bool checkEnPassantPin(int startSquare);
+    template <Colour Us> bool isLegalQuiet(Move move);
+
+    template <Colour Us, int Type> void generateLegalMoves(MoveList &moveList);
+    template <Colour Us, int Type> void generateKnightMoves(MoveList &moveList);
+    void addSlidingMoves(MoveList &moveList, uint64_t possibleMoves, int startSquare);
+    template <Colour Us, int Type> void generateSlidingMoves(MoveList &moveList);
+    template <Colour Us, int Type> void generateKingMoves(MoveList &moveList);
+    template <Colour Us, int StartSquareOffset> void addMovesFromBitmap(MoveList &moveList, uint64_t bitmap);
+
+    template <Colour Us> void makeMove(Move move);
 };
 
 #endif
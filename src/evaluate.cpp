@@ -1,8 +1,9 @@
 #include "evaluate.h"
+#include <algorithm>
 
 namespace evaluate {
 
-const int pieceSquareTables[6][64] = {
+constexpr int pieceSquareTables[6][64] = {
     {// pawn
      0,  0,   0,  0, 0,  0,  0,  0,   50,  50, 50, 50, 50, 50, 50, 50, 10, 10, 20, 30, 30,  20,
      10, 10,  5,  5, 10, 25, 25, 10,  5,   5,  0,  0,  0,  20, 20, 0,  0,  0,  5,  -5, -10, 0,
@@ -36,36 +37,42 @@ const int pieceSquareTables[6][64] = {
      -40, -30, -30, -40, -40, -50, -50, -40, -40, -30, -20, -30, -30, -40, -40, -30, -30, -20, -10, -20, -20, -20,
      -20, -20, -20, -10, 20,  20,  0,   0,   0,   0,   20,  20,  20,  30,  10,  0,   0,   10,  30,  20}};
 
-int sumPieceValues(Board board, bool isWhitePieces) {
-    const int pieceValues[6] = {100, 300, 320, 500, 900, 10000};
-    int colourValue = isWhitePieces ? 0 : 8;
-    int total = 0;
-    for (int i = 1; i < 7; i++) {
-        uint64_t bitboardCopy = board.getBitboard(colourValue + i);
-        while (bitboardCopy) {
-            int pieceSquare = std::countr_zero(bitboardCopy);
-            int file = pieceSquare & 7;
-            int rank = pieceSquare / 8;
-            if (isWhitePieces) {
-                rank = 7 - rank;
-            }
-            total += pieceValues[i - 1] + pieceSquareTables[i - 1][rank * 8 + file];
-            bitboardCopy &= bitboardCopy - 1;
+constexpr int kingEndgameTable[64] = {
+    -50, -40, -30, -20, -20, -30, -40, -50,
+    -30, -20, -10,   0,   0, -10, -20, -30,
+    -30, -10,  20,  30,  30,  20, -10, -30,
+    -30, -10,  30,  40,  40,  30, -10, -30,
+    -30, -10,  30,  40,  40,  30, -10, -30,
+    -30, -10,  20,  30,  30,  20, -10, -30,
+    -30, -30,   0,   0,   0,   0, -30, -30,
+    -50, -30, -30, -30, -30, -30, -30, -50,
+};
+
+constexpr std::array<std::array<int, 64>, 15> calculatePieceSquareScores(bool isEndgame) {
+    std::array<std::array<int, 64>, 15> scores = {};
+    for (int piece = 1; piece < 7; piece++) {
+        const int *table = isEndgame && piece == 6 ? kingEndgameTable : pieceSquareTables[piece - 1];
+        for (int square = 0; square < 64; square++) {
+            // Tables are laid out from white's point of view with the eighth rank first
+            int file = square & 7;
+            int rank = square / 8;
+            scores[piece][square] = pieceValues[piece - 1] + table[(7 - rank) * 8 + file];
+            scores[8 + piece][square] = -(pieceValues[piece - 1] + table[rank * 8 + file]);
         }
     }
-    return total;
+    return scores;
 }
 
-int evaluatePosition(Board board, int depth) {
-    int colourMultiplier = board.getIsWhiteTurn() ? 1 : -1;
-    if (board.getGameStatus() == 1) {
-        return -10000000 - depth;
-    }
-    if (board.getGameStatus() == 2) {
-        return 0;
-    }
+constexpr std::array<std::array<int, 64>, 15> midgameScores = calculatePieceSquareScores(false);
+constexpr std::array<std::array<int, 64>, 15> endgameScores = calculatePieceSquareScores(true);
+constexpr std::array<int, 15> phaseValues = {0, 0, 1, 1, 2, 4, 0, 0, 0, 0, 1, 1, 2, 4, 0};
 
-    int score = sumPieceValues(board, true) - sumPieceValues(board, false);
+/* Evaluation from the side to move's perspective, assuming the game has not ended. The board keeps the midgame and
+ * endgame scores up to date as moves are made, and they are blended by how much material is left. */
+int staticEvaluation(Board &board) {
+    int colourMultiplier = board.getIsWhiteTurn() ? 1 : -1;
+    int phase = std::min(board.getPhase(), MAX_PHASE);
+    int score = (board.getMidgameScore() * phase + board.getEndgameScore() * (MAX_PHASE - phase)) / MAX_PHASE;
     return colourMultiplier * score;
 }
 
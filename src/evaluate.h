@@ -2,11 +2,23 @@
 #define EVALUATE_H
 
 #include "board.h"
+#include <array>
+
+#define MAX_PHASE 24
 
 namespace evaluate {
 
-int sumPieceValues(Board board, bool isWhitePieces);
-int evaluatePosition(Board board, int depth = 0);
+// Material values of pawns, knights, bishops, rooks, queens and kings
+inline constexpr int pieceValues[6] = {100, 300, 320, 500, 900, 10000};
+
+/* Material plus piece-square score for each piece on each square, indexed like the bitboards. White pieces score
+ * positively and black pieces negatively. */
+extern const std::array<std::array<int, 64>, 15> midgameScores;
+extern const std::array<std::array<int, 64>, 15> endgameScores;
+// How much each piece counts towards the game phase, which is MAX_PHASE with all minor and major pieces on the board
+extern const std::array<int, 15> phaseValues;
+
+int staticEvaluation(Board &board);
 
 }
 
@@ -0,0 +1,35 @@
+#ifndef HASHTABLE_H
+#define HASHTABLE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+/* A hash table slot that threads share without locking. It stores the key xored with the data, so a slot torn by two
+ * threads writing at once fails the key check on load instead of returning mixed data. */
+struct LocklessSlot {
+    std::atomic<uint64_t> checksum;
+    std::atomic<uint64_t> data;
+
+    // Returns the key the slot was stored with, which only matches a real key if the slot isn't torn
+    uint64_t load(uint64_t &slotData) const {
+        slotData = data.load(std::memory_order_relaxed);
+        return checksum.load(std::memory_order_relaxed) ^ slotData;
+    }
+
+    void store(uint64_t key, uint64_t slotData) {
+        checksum.store(key ^ slotData, std::memory_order_relaxed);
+        data.store(slotData, std::memory_order_relaxed);
+    }
+};
+
+// Number of elements that fit in sizeMb, rounded down to a power of two so that an index is a mask of the hash
+inline uint64_t tableCapacity(int sizeMb, size_t elementSize) {
+    uint64_t capacity = 1;
+    while (capacity * 2 * elementSize <= (uint64_t)sizeMb * 1024 * 1024) {
+        capacity *= 2;
+    }
+    return capacity;
+}
+
+#endif
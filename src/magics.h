@@ -2,26 +2,152 @@
 #define MAGICS_H
 
 #include <array>
+#include <bit>
 #include <cstdint>
-#include <vector>
 
 namespace magics {
 
-uint64_t calculateOccupancyPermutation(uint64_t mask, int permutationNumber);
-uint64_t calculateBishopBlockMask(int square, uint64_t occupancyMask);
-uint64_t calculateRookBlockMask(int square, uint64_t occupancyMask);
+constexpr uint64_t calculateOccupancyPermutation(uint64_t mask, int permutationNumber) {
+    uint64_t permutation = 0;
+    int count = 0;
+    while (mask) {
+        int square = std::countr_zero(mask);
+        if (permutationNumber >> count & 1) {
+            permutation |= 1ULL << square;
+        }
+        count++;
+        mask -= 1ULL << square;
+    }
+    return permutation;
+}
+
+constexpr uint64_t calculateBishopBlockMask(int square, uint64_t occupancyMask) {
+    int file = square & 7;
+    int rank = square / 8;
+    uint64_t mask = 0;
+
+    for (int i = file - 1, j = rank - 1; i >= 0 && j >= 0; i--, j--) {
+        mask |= 1ULL << (j * 8 + i);
+        if (occupancyMask >> (j * 8 + i) & 1) {
+            break;
+        }
+    }
+    for (int i = file - 1, j = rank + 1; i >= 0 && j < 8; i--, j++) {
+        mask |= 1ULL << (j * 8 + i);
+        if (occupancyMask >> (j * 8 + i) & 1) {
+            break;
+        }
+    }
+    for (int i = file + 1, j = rank - 1; i < 8 && j >= 0; i++, j--) {
+        mask |= 1ULL << (j * 8 + i);
+        if (occupancyMask >> (j * 8 + i) & 1) {
+            break;
+        }
+    }
+    for (int i = file + 1, j = rank + 1; i < 8 && j < 8; i++, j++) {
+        mask |= 1ULL << (j * 8 + i);
+        if (occupancyMask >> (j * 8 + i) & 1) {
+            break;
+        }
+    }
+
+    return mask;
+}
+
+constexpr uint64_t calculateRookBlockMask(int square, uint64_t occupancyMask) {
+    int file = square & 7;
+    int rank = square / 8;
+    uint64_t mask = 0;
+
+    for (int i = file - 1; i >= 0; i--) {
+        mask |= 1ULL << (rank * 8 + i);
+        if (occupancyMask >> (rank * 8 + i) & 1) {
+            break;
+        }
+    }
+    for (int i = file + 1; i < 8; i++) {
+        mask |= 1ULL << (rank * 8 + i);
+        if (occupancyMask >> (rank * 8 + i) & 1) {
+            break;
+        }
+    }
+    for (int j = rank - 1; j >= 0; j--) {
+        mask |= 1ULL << (j * 8 + file);
+        if (occupancyMask >> (j * 8 + file) & 1) {
+            break;
+        }
+    }
+    for (int j = rank + 1; j < 8; j++) {
+        mask |= 1ULL << (j * 8 + file);
+        if (occupancyMask >> (j * 8 + file) & 1) {
+            break;
+        }
+    }
+
+    return mask;
+}
 
 extern const std::array<int, 64> bishopNumBits;
 extern const std::array<int, 64> rookNumBits;
 
-extern const std::array<uint64_t, 64> bishopOccupancyMasks;
-extern const std::array<uint64_t, 64> rookOccupancyMasks;
+inline constexpr std::array<uint64_t, 64> bishopOccupancyMasks = {
+    18049651735527936, 70506452091904,    275415828992,      1075975168,        38021120,         8657588224,
+    2216338399232,     567382630219776,   9024825867763712,  18049651735527424, 70506452221952,   275449643008,
+    9733406720,        2216342585344,     567382630203392,   1134765260406784,  4512412933816832, 9024825867633664,
+    18049651768822272, 70515108615168,    2491752130560,     567383701868544,   1134765256220672, 2269530512441344,
+    2256206450263040,  4512412900526080,  9024834391117824,  18051867805491712, 637888545440768,  1135039602493440,
+    2269529440784384,  4539058881568768,  1128098963916800,  2256197927833600,  4514594912477184, 9592139778506752,
+    19184279556981248, 2339762086609920,  4538784537380864,  9077569074761728,  562958610993152,  1125917221986304,
+    2814792987328512,  5629586008178688,  11259172008099840, 22518341868716544, 9007336962655232, 18014673925310464,
+    2216338399232,     4432676798464,     11064376819712,    22137335185408,    44272556441600,   87995357200384,
+    35253226045952,    70506452091904,    567382630219776,   1134765260406784,  2832480465846272, 5667157807464448,
+    11333774449049600, 22526811443298304, 9024825867763712,  18049651735527936,
+};
+
+inline constexpr std::array<uint64_t, 64> rookOccupancyMasks = {
+    282578800148862,     565157600297596,     1130315200595066,    2260630401190006,    4521260802379886,
+    9042521604759646,    18085043209519166,   36170086419038334,   282578800180736,     565157600328704,
+    1130315200625152,    2260630401218048,    4521260802403840,    9042521604775424,    18085043209518592,
+    36170086419037696,   282578808340736,     565157608292864,     1130315208328192,    2260630408398848,
+    4521260808540160,    9042521608822784,    18085043209388032,   36170086418907136,   282580897300736,
+    565159647117824,     1130317180306432,    2260632246683648,    4521262379438080,    9042522644946944,
+    18085043175964672,   36170086385483776,   283115671060736,     565681586307584,     1130822006735872,
+    2261102847592448,    4521664529305600,    9042787892731904,    18085034619584512,   36170077829103616,
+    420017753620736,     699298018886144,     1260057572672512,    2381576680245248,    4624614895390720,
+    9110691325681664,    18082844186263552,   36167887395782656,   35466950888980736,   34905104758997504,
+    34344362452452352,   33222877839362048,   30979908613181440,   26493970160820224,   17522093256097792,
+    35607136465616896,   9079539427579068672, 8935706818303361536, 8792156787827803136, 8505056726876686336,
+    7930856604974452736, 6782456361169985536, 4485655873561051136, 9115426935197958144,
+};
 
 extern const std::array<uint64_t, 64> bishopMagics;
 extern const std::array<uint64_t, 64> rookMagics;
 
-extern const std::vector<std::vector<uint64_t>> bishopLookupTable;
-extern const std::vector<std::vector<uint64_t>> rookLookupTable;
+// Offset of a square's attack sets in attackTable, along with what is needed to index them
+struct MagicEntry {
+    uint64_t mask;
+    uint64_t magic;
+    uint32_t offset;
+    uint32_t shift;
+};
+
+#define BISHOP_TABLE_SIZE 5248
+#define ROOK_TABLE_SIZE 102400
+
+extern const std::array<MagicEntry, 64> bishopMagicEntries;
+extern const std::array<MagicEntry, 64> rookMagicEntries;
+// Bishop attack sets for every square followed by rook attack sets for every square
+extern const std::array<uint64_t, BISHOP_TABLE_SIZE + ROOK_TABLE_SIZE> attackTable;
+
+inline uint64_t bishopAttacks(int square, uint64_t occupancy) {
+    const MagicEntry &entry = bishopMagicEntries[square];
+    return attackTable[entry.offset + ((occupancy & entry.mask) * entry.magic >> entry.shift)];
+}
+
+inline uint64_t rookAttacks(int square, uint64_t occupancy) {
+    const MagicEntry &entry = rookMagicEntries[square];
+    return attackTable[entry.offset + ((occupancy & entry.mask) * entry.magic >> entry.shift)];
+}
 
 extern const std::array<uint64_t, 793> zobristKeys;
 
@@ -1,4 +1,7 @@
+#include "attacks.h"
+#include "bench.h"
 #include "board.h"
+#include "perft.h"
 #include "search.h"
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_image.h>
@@ -6,30 +9,34 @@
 #include <chrono>
 #include <cstdint>
 #include <map>
+#include <mutex>
+#include <thread>
 
 #define WINDOW_SIZE 1200
 #define SQUARE_SIZE (WINDOW_SIZE / 8)
 
-const std::array<std::string, 64> squareNotation = {
-    "a1", "b1", "c1", "d1", "e1", "f1", "g1", "h1", "a2", "b2", "c2", "d2", "e2", "f2", "g2", "h2",
-    "a3", "b3", "c3", "d3", "e3", "f3", "g3", "h3", "a4", "b4", "c4", "d4", "e4", "f4", "g4", "h4",
-    "a5", "b5", "c5", "d5", "e5", "f5", "g5", "h5", "a6", "b6", "c6", "d6", "e6", "f6", "g6", "h6",
-    "a7", "b7", "c7", "d7", "e7", "f7", "g7", "h7", "a8", "b8", "c8", "d8", "e8", "f8", "g8", "h8",
-};
-
 struct BotSettings {
     bool enabled;
     bool AIControlsWhite;
+    int moveTime;
+    int threads;
 };
 
 class GameController {
   public:
     GameController(std::string _startingPos, BotSettings _botSettings)
-        : board(_startingPos), botSettings(_botSettings), searcher() {
+        : board(_startingPos), botSettings(_botSettings), searcher(), searchFinished(false), pondering(false) {
         startingPos = _startingPos;
+        searcher.setThreads(botSettings.threads);
+        searcher.setInfoCallback([this](const SearchInfo &info) {
+            std::lock_guard<std::mutex> lock(progressMutex);
+            progress = info;
+        });
     }
 
-    std::array<short, 64> getPieceArray() {
+    ~GameController() { cancelAISearch(); }
+
+    std::array<uint8_t, 64> getPieceArray() {
         return board.getState();
     }
 
@@ -49,8 +56,7 @@ class GameController {
     bool isGameOver() { return board.getGameStatus() != 0; }
 
     int calculateFlag(int startSquare, int destinationSquare) {
-        std::vector<Move> moves = board.getMoves();
-        for (Move move : moves) {
+        for (Move move : board.getMoves()) {
             if (startSquare == move.getStart() && destinationSquare == move.getDestination()) {
                 return move.getFlags();
             }
@@ -63,12 +69,63 @@ class GameController {
     }
 
     void makeMove(Move move) {
+        resolvePonderSearch(move);
         board.makeMove(move);
     }
 
-    void makeAIMove() {
-        Move bestMove = searcher.getBestMove(board);
-        board.makeMove(bestMove);
+    bool isAIThinking() { return searchThread.joinable(); }
+
+    bool isPondering() { return pondering; }
+
+    Move getPonderMove() { return ponderMove; }
+
+    void startAISearch() {
+        if (isAIThinking()) {
+            return;
+        }
+        SearchLimits limits;
+        limits.moveTime = botSettings.moveTime;
+        startSearch(board, limits);
+    }
+
+    // Called every frame, plays the bot's move once its search has finished without ever waiting for it
+    void pollAISearch() {
+        if (!isAIThinking() || !searchFinished || pondering) {
+            return;
+        }
+        searchThread.join();
+        board.makeMove(searchResult);
+        startPonderSearch(searcher.getPonderMove());
+    }
+
+    // Abandons the current search without playing its move
+    void cancelAISearch() {
+        if (!isAIThinking()) {
+            return;
+        }
+        searcher.stop();
+        searchThread.join();
+        pondering = false;
+    }
+
+    void newGame() {
+        cancelAISearch();
+        searcher.newGame();
+        board = Board(startingPos);
+    }
+
+    // Last completed iteration of the running search, with the node count brought up to date
+    SearchInfo getSearchProgress() {
+        SearchInfo info;
+        {
+            std::lock_guard<std::mutex> lock(progressMutex);
+            info = progress;
+        }
+        // Until the first iteration completes the searcher may still hold the previous search's count
+        if (info.depth) {
+            info.nodes = searcher.getNodes();
+        }
+        return info;
     }
 
     void makePromotionMove(int column, int row, int startSquare, int destinationSquare) {
@@ -77,7 +134,41 @@ class GameController {
         if (board.getState()[destinationSquare]) {
             flags |= 4;
         }
-        board.makeMove(Move(startSquare, destinationSquare, flags));
+        makeMove(Move(startSquare, destinationSquare, flags));
+    }
+
+    /* Keeps searching while the human thinks, from the position after the reply the bot expects. Until the human moves
+     * the search ignores its time limit. */
+    void startPonderSearch(Move expectedReply) {
+        if (!expectedReply.getValue() || isAITurn() || isGameOver()) {
+            return;
+        }
+        Board ponderBoard = board;
+        ponderBoard.makeMove(expectedReply);
+        if (ponderBoard.getGameStatus()) {
+            return;
+        }
+        SearchLimits limits;
+        limits.moveTime = botSettings.moveTime;
+        limits.ponder = true;
+        pondering = true;
+        ponderMove = expectedReply;
+        startSearch(ponderBoard, limits);
+    }
+
+    /* On a ponder hit the search carries on as the bot's search, keeping its transposition table and iterations, with
+     * the move time counted from now. Any other move makes it worthless. The search was prepared before its thread
+     * started, so a hit is never overwritten by the search starting late. */
+    void resolvePonderSearch(Move move) {
+        if (!pondering) {
+            return;
+        }
+        if (move == ponderMove) {
+            searcher.ponderhit();
+            pondering = false;
+        } else {
+            cancelAISearch();
+        }
     }
 
     void perftTimer(int plyDepth) {
@@ -86,7 +177,7 @@ class GameController {
             std::chrono::duration start = std::chrono::high_resolution_clock().now().time_since_epoch();
             int startMs = std::chrono::duration_cast<std::chrono::microseconds>(start).count();
 
-            int moves = perft(i);
+            uint64_t moves = perft::perft(board, i);
 
             std::chrono::duration end = std::chrono::high_resolution_clock().now().time_since_epoch();
             int endMs = std::chrono::duration_cast<std::chrono::microseconds>(end).count();
@@ -106,26 +197,30 @@ class GameController {
     BotSettings botSettings;
     Searcher searcher;
 
-    int perft(int depth, bool topLevel = true) {
-        if (depth == 0) {
-            return 1;
-        }
-        int totalMoves = 0;
-        std::vector<Move> moves = board.getMoves();
-        for (Move move : moves) {
-            board.makeMove(move);
-            int numMoves = perft(depth - 1, false);
-            board.unmakeMove(move);
-            /*
-            if (topLevel) {
-                std::cout << squareNotation[move.getStart()] << "->" << squareNotation[move.getDestination()] << ", "
-                          << move.getFlags() << ": " << numMoves << '\n';
-            }
-            */
-            totalMoves += numMoves;
+    // Searches on a worker thread so the window keeps drawing and handling events while the bot thinks
+    void startSearch(const Board &searchBoard, SearchLimits limits) {
+        {
+            std::lock_guard<std::mutex> lock(progressMutex);
+            progress = SearchInfo();
         }
-        return totalMoves;
+        searchFinished = false;
+        // Before the thread starts, so that cancelling the search or a ponder hit straight away isn't lost
+        searcher.prepare(limits);
+        searchThread = std::thread([this, limits, searchBoard] {
+            searchResult = searcher.getBestMove(searchBoard, limits);
+            searchFinished = true;
+        });
     }
+
+    std::thread searchThread;
+    std::atomic<bool> searchFinished;
+    Move searchResult;
+    // Whether the running search is on the position after ponderMove, which the human hasn't played yet
+    bool pondering;
+    Move ponderMove;
+    // Written by the search thread's info callback and read when drawing
+    std::mutex progressMutex;
+    SearchInfo progress;
 };
 
 class PromotionMenu {
@@ -160,7 +255,7 @@ class PromotionMenu {
     }
 };
 
-void drawPieces(SDL_Renderer *renderer, SDL_Texture *pieceTextures[14], std::array<short, 64> pieceArray) {
+void drawPieces(SDL_Renderer *renderer, SDL_Texture *pieceTextures[14], std::array<uint8_t, 64> pieceArray) {
     for (int rank = 0; rank < 8; rank++) {
         for (int file = 0; file < 8; file++) {
             int squareValue = pieceArray[rank * 8 + file];
@@ -208,11 +303,26 @@ void drawOpponentAttackMap(SDL_Renderer *renderer, uint64_t opponentAttackMap) {
     }
 }
 
+// Marks the start and destination squares of the move the bot currently thinks is best
+void drawSearchMove(SDL_Renderer *renderer, Move move) {
+    SDL_SetRenderDrawColor(renderer, 0x00, 0x60, 0xff, 0x55);
+    for (int square : {move.getStart(), move.getDestination()}) {
+        int file = square & 7;
+        int rank = 7 - square / 8;
+        SDL_Rect rect = {file * SQUARE_SIZE, rank * SQUARE_SIZE, SQUARE_SIZE, SQUARE_SIZE};
+        SDL_RenderFillRect(renderer, &rect);
+    }
+}
+
 int main(int argc, char *argv[]) {
 
     std::string startingPos = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
     int plyDepth = -1;
-    BotSettings botSettings = {false, false};
+    int divideDepth = -1;
+    int perftSuiteDepth = -1;
+    int perftHashSize = 0;
+    int benchmarkDepth = -1;
+    BotSettings botSettings = {false, false, 1000, 1};
 
     for (int i = 1; i < argc; i++) {
         if (!strcmp(argv[i], "-b")) {
@@ -221,6 +331,32 @@ int main(int argc, char *argv[]) {
         } else if (!strcmp(argv[i], "-p")) {
             i++;
             plyDepth = atoi(argv[i]);
+        } else if (!strcmp(argv[i], "-d")) {
+            i++;
+            divideDepth = atoi(argv[i]);
+        } else if (!strcmp(argv[i], "-P")) {
+            i++;
+            perftSuiteDepth = atoi(argv[i]);
+        } else if (!strcmp(argv[i], "-H")) {
+            i++;
+            perftHashSize = atoi(argv[i]);
+        } else if (!strcmp(argv[i], "-s")) {
+            i++;
+            benchmarkDepth = atoi(argv[i]);
+        } else if (!strcmp(argv[i], "-t")) {
+            i++;
+            botSettings.moveTime = atoi(argv[i]);
+        } else if (!strcmp(argv[i], "-j")) {
+            i++;
+            botSettings.threads = atoi(argv[i]);
+        } else if (!strcmp(argv[i], "-a")) {
+            i++;
+            // Slider attack backend, so perft speeds can be compared
+            int backend = !strcmp(argv[i], "pext") ? BACKEND_PEXT : BACKEND_MAGIC;
+            if ((backend == BACKEND_MAGIC && strcmp(argv[i], "magic")) || !attacks::setBackend(backend)) {
+                std::cout << "Unsupported attack backend" << '\n';
+                return 1;
+            }
         } else if (!strcmp(argv[i], "-c")) {
             i++;
             botSettings.enabled = true;
@@ -243,6 +379,21 @@ int main(int argc, char *argv[]) {
         return 0;
     }
 
+    if (divideDepth >= 0) {
+        Board board(startingPos);
+        perft::divide(board, divideDepth);
+        return 0;
+    }
+
+    if (perftSuiteDepth >= 0) {
+        return perft::runSuite(perftSuiteDepth, botSettings.threads, perftHashSize) ? 0 : 1;
+    }
+
+    if (benchmarkDepth >= 0) {
+        bench::searchBenchmark(benchmarkDepth);
+        return 0;
+    }
+
     SDL_Init(SDL_INIT_VIDEO);
     IMG_Init(IMG_INIT_PNG);
     SDL_Window *window =
@@ -272,6 +423,7 @@ int main(int argc, char *argv[]) {
     int startSquare = -1;
     int squareClicked = -1;
     std::set<int> moveOptions;
+    std::string windowTitle = "Chess Engine";
 
     while (running) {
 
@@ -279,6 +431,12 @@ int main(int argc, char *argv[]) {
             if (event.type == SDL_QUIT) {
                 running = false;
             }
+            if (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_n) {
+                gameController.newGame();
+                promotionMenu.display = false;
+                startSquare = -1;
+                moveOptions.clear();
+            }
             if (event.type == SDL_MOUSEBUTTONDOWN && !gameController.isGameOver() && !gameController.isAITurn()) {
                 if (promotionMenu.display) {
                     if (promotionMenu.isClicked(event.button.x, event.button.y)) {
@@ -322,6 +480,11 @@ int main(int argc, char *argv[]) {
             }
         }
 
+        gameController.pollAISearch();
+        if (gameController.isAITurn()) {
+            gameController.startAISearch();
+        }
+
         SDL_RenderClear(renderer);
         drawBoard(renderer);
 
@@ -330,6 +493,24 @@ int main(int argc, char *argv[]) {
         }
         // drawOpponentAttackMap(renderer, board.getOpponentAttackMap());
 
+        // There is no font to draw text with, so the search progress goes in the title bar
+        std::string title = "Chess Engine";
+        if (gameController.isAIThinking()) {
+            SearchInfo progress = gameController.getSearchProgress();
+            bool isPondering = gameController.isPondering();
+            title += isPondering ? " - pondering on " + gameController.getPonderMove().toString() : " - thinking";
+            title += ": depth " + std::to_string(progress.depth) + ", " + std::to_string(progress.nodes) + " nodes";
+            // A ponder search's best move is for a position that isn't on the board yet
+            if (!progress.principalVariation.empty() && !isPondering) {
+                drawSearchMove(renderer, progress.principalVariation[0]);
+                title += ", best " + progress.principalVariation[0].toString();
+            }
+        }
+        if (title != windowTitle) {
+            windowTitle = title;
+            SDL_SetWindowTitle(window, windowTitle.c_str());
+        }
+
         drawPieces(renderer, pieceTextures, gameController.getPieceArray());
 
         if (promotionMenu.display) {
@@ -338,12 +519,10 @@ int main(int argc, char *argv[]) {
 
         SDL_RenderPresent(renderer);
         SDL_Delay(20);
-
-        if (gameController.isAITurn()) {
-            gameController.makeAIMove();
-        }
     }
 
+    gameController.cancelAISearch();
+
     for (int i = 0; i < 14; i++) {
         if (i == 6 || i == 7)
             continue;
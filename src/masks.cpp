@@ -2,7 +2,7 @@
 
 namespace masks {
 
-std::array<std::array<int, 8>, 64> calculateNumSquaresToEdge() {
+constexpr std::array<std::array<int, 8>, 64> calculateNumSquaresToEdge() {
     std::array<std::array<int, 8>, 64> numSquaresToEdge;
     for (int rank = 0; rank < 8; rank++) {
         for (int file = 0; file < 8; file++) {
@@ -26,7 +26,7 @@ std::array<std::array<int, 8>, 64> calculateNumSquaresToEdge() {
     return numSquaresToEdge;
 }
 
-std::array<uint64_t, 64> calculateKnightMasks() {
+constexpr std::array<uint64_t, 64> calculateKnightMasks() {
     std::array<uint64_t, 64> knightMask;
     int knightMoveOffsets[8] = {10, -6, 17, -15, -17, 15, 6, -10};
     int start = 0;
@@ -55,7 +55,7 @@ std::array<uint64_t, 64> calculateKnightMasks() {
     return knightMask;
 }
 
-std::array<uint64_t, 64> calculateBishopMasks() {
+constexpr std::array<uint64_t, 64> calculateBishopMasks() {
     std::array<uint64_t, 64> bishopMask;
     int bishopMoveOffsets[4] = {7, -7, -9, 9};
     for (int square = 0; square < 64; square++) {
@@ -70,7 +70,7 @@ std::array<uint64_t, 64> calculateBishopMasks() {
     return bishopMask;
 }
 
-std::array<uint64_t, 64> calculateRookMasks() {
+constexpr std::array<uint64_t, 64> calculateRookMasks() {
     std::array<uint64_t, 64> rookMask;
     int rookMoveOffsets[4] = {8, -8, -1, 1};
     for (int square = 0; square < 64; square++) {
@@ -85,7 +85,7 @@ std::array<uint64_t, 64> calculateRookMasks() {
     return rookMask;
 }
 
-std::array<uint64_t, 64> calculateKingMasks() {
+constexpr std::array<uint64_t, 64> calculateKingMasks() {
     std::array<uint64_t, 64> kingMask;
     int kingMoveOffsets[9] = {8, 9, 1, -7, -8, -9, -1, 7, 8};
     int start = 0;
@@ -112,10 +112,10 @@ std::array<uint64_t, 64> calculateKingMasks() {
     return kingMask;
 }
 
-const std::array<std::array<int, 8>, 64> numSquaresToEdge = calculateNumSquaresToEdge();
-const std::array<uint64_t, 64> knightMoveMasks = calculateKnightMasks();
-const std::array<uint64_t, 64> bishopMoveMasks = calculateBishopMasks();
-const std::array<uint64_t, 64> rookMoveMasks = calculateRookMasks();
-const std::array<uint64_t, 64> kingMoveMasks = calculateKingMasks();
+constexpr std::array<std::array<int, 8>, 64> numSquaresToEdge = calculateNumSquaresToEdge();
+constexpr std::array<uint64_t, 64> knightMoveMasks = calculateKnightMasks();
+constexpr std::array<uint64_t, 64> bishopMoveMasks = calculateBishopMasks();
+constexpr std::array<uint64_t, 64> rookMoveMasks = calculateRookMasks();
+constexpr std::array<uint64_t, 64> kingMoveMasks = calculateKingMasks();
 
 } // namespace masks
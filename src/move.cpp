@@ -23,12 +23,27 @@ Move::Move(unsigned int start, unsigned int destination, unsigned int flags) {
     move = ((flags & 0xf) << 12) | ((start & 0x3f) << 6) | (destination & 0x3f);
 }
 
-unsigned int Move::getStart() { return (move >> 6) & 0x3f; }
+Move::Move(uint16_t value) { move = value; }
 
-unsigned int Move::getDestination() { return move & 0x3f; }
+unsigned int Move::getStart() const { return (move >> 6) & 0x3f; }
 
-unsigned int Move::isCapture() { return (move >> 14) & 1; }
+unsigned int Move::getDestination() const { return move & 0x3f; }
 
-unsigned int Move::isPromotion() { return move >> 15; }
+unsigned int Move::isCapture() const { return (move >> 14) & 1; }
 
-unsigned int Move::getFlags() { return (move >> 12) & 0xf; }
+unsigned int Move::isPromotion() const { return move >> 15; }
+
+unsigned int Move::getFlags() const { return (move >> 12) & 0xf; }
+
+uint16_t Move::getValue() const { return move; }
+
+// Long algebraic notation, e.g. e2e4 or e7e8q
+std::string Move::toString() const {
+    const std::string promotionPieces = "nbrq";
+    std::string notation = {(char)('a' + (getStart() & 7)), (char)('1' + getStart() / 8),
+                            (char)('a' + (getDestination() & 7)), (char)('1' + getDestination() / 8)};
+    if (isPromotion()) {
+        notation += promotionPieces[getFlags() & 3];
+    }
+    return notation;
+}
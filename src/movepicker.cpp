@@ -0,0 +1,154 @@
+#include "movepicker.h"
+#include <utility>
+
+// Most valuable victim, least valuable attacker, with promotions ordered by the promoted piece
+static int mvvLva(Board &board, Move move) {
+    int attacker = board.getPiece(move.getStart()) & 7;
+    int score = -attacker;
+    if (move.isCapture()) {
+        int victim = move.getFlags() == 5 ? 1 : board.getPiece(move.getDestination()) & 7;
+        score += victim * 8;
+    }
+    if (move.isPromotion()) {
+        score += ((move.getFlags() & 3) + 2) * 8;
+    }
+    return score;
+}
+
+MovePicker::MovePicker(Board &_board, uint16_t _hashMove, const std::array<Move, 2> &killers, Move counterMove,
+                       const std::array<std::array<int, 64>, 64> &_history)
+    : board(_board), history(&_history), hashMove(_hashMove), refutations({killers[0], killers[1], counterMove}),
+      refutationIndex(0), capturesOnly(false), stage(STAGE_HASH_MOVE), capturesGenerated(false), capturesEnd(0),
+      badCapturesEnd(0), index(0) {}
+
+MovePicker::MovePicker(Board &_board)
+    : board(_board), history(nullptr), hashMove(0), refutations(), refutationIndex(0), capturesOnly(true),
+      stage(STAGE_GENERATE_CAPTURES), capturesGenerated(false), capturesEnd(0), badCapturesEnd(0), index(0) {}
+
+bool MovePicker::nextMove(Move &move) {
+    switch (stage) {
+    case STAGE_HASH_MOVE:
+        stage = STAGE_GENERATE_CAPTURES;
+        if (hashMove) {
+            // A capture is checked against the generated captures, which are needed next anyway
+            generateCaptures();
+            Move hash(hashMove);
+            bool isQuiet = !hash.isCapture() && !hash.isPromotion();
+            if (isQuiet ? board.isLegalQuiet(hash) : contains(hashMove, 0, capturesEnd)) {
+                move = hash;
+                return true;
+            }
+        }
+        [[fallthrough]];
+
+    case STAGE_GENERATE_CAPTURES:
+        generateCaptures();
+        for (int i = 0; i < capturesEnd; i++) {
+            moves.score(i) = mvvLva(board, moves[i]);
+        }
+        index = 0;
+        stage = STAGE_CAPTURES;
+        [[fallthrough]];
+
+    case STAGE_CAPTURES:
+        while (index < capturesEnd) {
+            move = pickBest(capturesEnd);
+            if (move.getValue() == hashMove) {
+                continue;
+            }
+            if (!board.seeGE(move, 0)) {
+                std::swap(moves[badCapturesEnd++], moves[index - 1]);
+                continue;
+            }
+            return true;
+        }
+        if (capturesOnly) {
+            stage = STAGE_DONE;
+            return false;
+        }
+        stage = STAGE_REFUTATIONS;
+        [[fallthrough]];
+
+    case STAGE_REFUTATIONS:
+        while (refutationIndex < (int)refutations.size()) {
+            Move refutation = refutations[refutationIndex++];
+            uint16_t value = refutation.getValue();
+            // The counter move may also be one of the killers
+            bool isDuplicate = refutationIndex == 3 && (refutation == refutations[0] || refutation == refutations[1]);
+            if (value && value != hashMove && !isDuplicate && board.isLegalQuiet(refutation)) {
+                move = refutation;
+                return true;
+            }
+        }
+        stage = STAGE_GENERATE_QUIETS;
+        [[fallthrough]];
+
+    case STAGE_GENERATE_QUIETS:
+        board.generateQuiets(moves);
+        for (int i = capturesEnd; i < moves.size(); i++) {
+            moves.score(i) = (*history)[moves[i].getStart()][moves[i].getDestination()];
+        }
+        index = capturesEnd;
+        stage = STAGE_QUIETS;
+        [[fallthrough]];
+
+    case STAGE_QUIETS:
+        while (index < moves.size()) {
+            move = pickBest(moves.size());
+            if (move.getValue() != hashMove && !isRefutation(move)) {
+                return true;
+            }
+        }
+        index = 0;
+        stage = STAGE_BAD_CAPTURES;
+        [[fallthrough]];
+
+    case STAGE_BAD_CAPTURES:
+        if (index < badCapturesEnd) {
+            move = moves[index++];
+            return true;
+        }
+        stage = STAGE_DONE;
+        [[fallthrough]];
+
+    default:
+        return false;
+    }
+}
+
+void MovePicker::generateCaptures() {
+    if (capturesGenerated) {
+        return;
+    }
+    capturesGenerated = true;
+    board.generateCaptures(moves);
+    capturesEnd = moves.size();
+}
+
+bool MovePicker::contains(uint16_t move, int start, int end) {
+    for (int i = start; i < end; i++) {
+        if (moves[i].getValue() == move) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool MovePicker::isRefutation(Move move) {
+    return move == refutations[0] || move == refutations[1] || move == refutations[2];
+}
+
+// One step of a selection sort, as a cutoff usually comes before most of the moves are searched
+Move MovePicker::pickBest(int end) {
+    int best = index;
+    for (int i = index + 1; i < end; i++) {
+        if (moves.score(i) > moves.score(best)) {
+            best = i;
+        }
+    }
+    if (best != index) {
+        std::swap(moves[index], moves[best]);
+        std::swap(moves.score(index), moves.score(best));
+    }
+    return moves[index++];
+}
@@ -0,0 +1,56 @@
+#ifndef MOVEPICKER_H
+#define MOVEPICKER_H
+
+#include "board.h"
+#include <array>
+#include <cstdint>
+
+#define STAGE_HASH_MOVE 0
+#define STAGE_GENERATE_CAPTURES 1
+#define STAGE_CAPTURES 2
+#define STAGE_REFUTATIONS 3
+#define STAGE_GENERATE_QUIETS 4
+#define STAGE_QUIETS 5
+#define STAGE_BAD_CAPTURES 6
+#define STAGE_DONE 7
+
+/* Hands out the legal moves of a position one at a time in stages: the hash move, captures and promotions that don't
+ * lose material by most valuable victim, the killer and counter moves, the remaining quiet moves by history, then the
+ * captures that static exchange evaluation says lose material. Each stage's moves are only generated once it is
+ * reached, so a cutoff early on skips generating the quiet moves altogether. The hash move and refutations come from
+ * other positions, so they are checked for legality first: captures against the generated captures and quiet moves
+ * with Board::isLegalQuiet. */
+class MovePicker {
+  public:
+    MovePicker(Board &board, uint16_t hashMove, const std::array<Move, 2> &killers, Move counterMove,
+               const std::array<std::array<int, 64>, 64> &history);
+    // Captures and promotions that don't lose material only, for quiescence search
+    MovePicker(Board &board);
+
+    bool nextMove(Move &move);
+
+  private:
+    Board &board;
+    const std::array<std::array<int, 64>, 64> *history;
+    uint16_t hashMove;
+    // Killer moves followed by the counter move
+    std::array<Move, 3> refutations;
+    int refutationIndex;
+    bool capturesOnly;
+
+    int stage;
+    /* Captures are generated into the start of the list and quiet moves after them. Losing captures are moved to the
+     * front of the list as they are picked, as every move before the current index has already been handed out. */
+    MoveList moves;
+    bool capturesGenerated;
+    int capturesEnd;
+    int badCapturesEnd;
+    int index;
+
+    void generateCaptures();
+    bool contains(uint16_t move, int start, int end);
+    bool isRefutation(Move move);
+    Move pickBest(int end);
+};
+
+#endif
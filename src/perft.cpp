@@ -0,0 +1,202 @@
+#include "perft.h"
+#include "attacks.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <string>
+#include <vector>
+
+namespace perft {
+
+struct PerftPosition {
+    std::string name;
+    std::string fen;
+    // Expected node counts from depth 1 upwards
+    std::vector<uint64_t> nodes;
+};
+
+// Source: https://www.chessprogramming.org/Perft_Results
+const std::vector<PerftPosition> perftPositions = {
+    {"startpos",
+     "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+     {20, 400, 8902, 197281, 4865609, 119060324, 3195901860, 84998978956}},
+    {"kiwipete",
+     "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+     {48, 2039, 97862, 4085603, 193690690, 8031647685}},
+    {"position 3",
+     "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+     {14, 191, 2812, 43238, 674624, 11030083, 178633661, 3009794393}},
+    {"position 4",
+     "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+     {6, 264, 9467, 422333, 15833292, 706045033}},
+    {"position 5", "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8", {44, 1486, 62379, 2103487, 89941194}},
+    {"position 6",
+     "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+     {46, 2079, 89890, 3894594, 164075551, 6923051137}},
+};
+
+PerftTable::PerftTable(int sizeMb) {
+    uint64_t numEntries = tableCapacity(sizeMb, sizeof(LocklessSlot));
+    entries = std::vector<LocklessSlot>(numEntries);
+    indexMask = numEntries - 1;
+    for (LocklessSlot &entry : entries) {
+        entry.store(0, 0);
+    }
+}
+
+// The data holds the node count in the upper 56 bits and the depth in the lowest 8
+bool PerftTable::probe(uint64_t hash, int depth, uint64_t &nodes) {
+    uint64_t data;
+    if (entries[(hash ^ depth) & indexMask].load(data) != hash || (int)(data & 0xff) != depth) {
+        return false;
+    }
+    nodes = data >> 8;
+    return true;
+}
+
+void PerftTable::store(uint64_t hash, int depth, uint64_t nodes) {
+    entries[(hash ^ depth) & indexMask].store(hash, nodes << 8 | depth);
+}
+
+// Counts leaf nodes, returning the number of legal moves at depth 1 instead of making each of them
+uint64_t perft(Board &board, int depth) {
+    if (depth == 0) {
+        return 1;
+    }
+    MoveList moves;
+    board.generateMoves(moves);
+    if (depth == 1) {
+        return moves.size();
+    }
+    uint64_t totalMoves = 0;
+    for (Move move : moves) {
+        board.makeMove(move);
+        totalMoves += perft(board, depth - 1);
+        board.unmakeMove();
+    }
+    return totalMoves;
+}
+
+uint64_t perft(Board &board, int depth, PerftTable &table) {
+    if (depth <= 1) {
+        return perft(board, depth);
+    }
+    uint64_t totalMoves;
+    if (table.probe(board.getHash(), depth, totalMoves)) {
+        return totalMoves;
+    }
+
+    totalMoves = 0;
+    MoveList moves;
+    board.generateMoves(moves);
+    for (Move move : moves) {
+        board.makeMove(move);
+        totalMoves += perft(board, depth - 1, table);
+        board.unmakeMove();
+    }
+    table.store(board.getHash(), depth, totalMoves);
+    return totalMoves;
+}
+
+/* Splits the tree at the first two plies into one task per pair of moves, which the threads take from a shared queue
+ * so that a few large subtrees don't leave the other threads idle. A hash size of 0 disables the perft table. */
+uint64_t parallelPerft(Board &board, int depth, int threads, int hashSizeMb) {
+    if (depth <= 2) {
+        return perft(board, depth);
+    }
+
+    std::vector<std::vector<Move>> tasks;
+    MoveList rootMoves;
+    board.generateMoves(rootMoves);
+    for (Move rootMove : rootMoves) {
+        board.makeMove(rootMove);
+        MoveList replies;
+        board.generateMoves(replies);
+        for (Move reply : replies) {
+            tasks.push_back({rootMove, reply});
+        }
+        board.unmakeMove();
+    }
+
+    PerftTable table(hashSizeMb);
+    std::atomic<int> nextTask = 0;
+    std::atomic<uint64_t> totalMoves = 0;
+
+    auto worker = [&](Board threadBoard) {
+        uint64_t threadMoves = 0;
+        for (int i = nextTask++; i < (int)tasks.size(); i = nextTask++) {
+            for (Move move : tasks[i]) {
+                threadBoard.makeMove(move);
+            }
+            threadMoves += hashSizeMb ? perft(threadBoard, depth - 2, table) : perft(threadBoard, depth - 2);
+            for (int j = 0; j < (int)tasks[i].size(); j++) {
+                threadBoard.unmakeMove();
+            }
+        }
+        totalMoves += threadMoves;
+    };
+
+    std::vector<std::thread> workers;
+    for (int i = 0; i < std::max(threads, 1); i++) {
+        workers.emplace_back(worker, board);
+    }
+    for (std::thread &thread : workers) {
+        thread.join();
+    }
+    return totalMoves;
+}
+
+// Perft that prints the node count below each root move, for finding move generation bugs
+uint64_t divide(Board &board, int depth) {
+    MoveList moves;
+    board.generateMoves(moves);
+    uint64_t totalMoves = 0;
+    for (Move move : moves) {
+        board.makeMove(move);
+        uint64_t numMoves = depth > 1 ? perft(board, depth - 1) : 1;
+        board.unmakeMove();
+        std::cout << move.toString() << ": " << numMoves << '\n';
+        totalMoves += numMoves;
+    }
+    std::cout << '\n' << "Nodes searched: " << totalMoves << '\n';
+    return totalMoves;
+}
+
+/* Checks the node counts of the standard perft positions up to maxDepth and reports the speed. With more than one
+ * thread or a perft table the positions are split across the threads. */
+bool runSuite(int maxDepth, int threads, int hashSizeMb) {
+    bool passed = true;
+    uint64_t totalNodes = 0;
+    double totalTime = 0;
+
+    std::cout << "Slider attacks: " << attacks::getBackendName() << '\n';
+    for (const PerftPosition &position : perftPositions) {
+        int depth = std::min(maxDepth, (int)position.nodes.size());
+        Board board(position.fen);
+
+        auto start = std::chrono::steady_clock::now();
+        uint64_t nodes =
+            threads > 1 || hashSizeMb ? parallelPerft(board, depth, threads, hashSizeMb) : perft(board, depth);
+        double timeElapsed =
+            std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+
+        uint64_t expected = position.nodes[depth - 1];
+        double nps = timeElapsed ? (double)nodes / timeElapsed * 1000000 : 0;
+        std::cout << position.name << " depth " << depth << ": " << nodes << (nodes == expected ? " ok " : " FAILED ")
+                  << timeElapsed / 1000 << "ms @ " << nps << "n/s" << '\n';
+        if (nodes != expected) {
+            std::cout << "    expected " << expected << '\n';
+            passed = false;
+        }
+        totalNodes += nodes;
+        totalTime += timeElapsed;
+    }
+
+    double nps = totalTime ? (double)totalNodes / totalTime * 1000000 : 0;
+    std::cout << "Total: " << totalNodes << " nodes " << totalTime / 1000 << "ms @ " << nps << "n/s" << '\n';
+    std::cout << (passed ? "All perft counts correct" : "Perft counts incorrect") << '\n';
+    return passed;
+}
+
+} // namespace perft
@@ -0,0 +1,32 @@
+#ifndef PERFT_H
+#define PERFT_H
+
+#include "board.h"
+#include "hashtable.h"
+#include <cstdint>
+#include <vector>
+
+namespace perft {
+
+// Node counts of positions already searched, keyed by the Zobrist hash and remaining depth and shared between threads
+class PerftTable {
+  public:
+    PerftTable(int sizeMb);
+
+    bool probe(uint64_t hash, int depth, uint64_t &nodes);
+    void store(uint64_t hash, int depth, uint64_t nodes);
+
+  private:
+    std::vector<LocklessSlot> entries;
+    uint64_t indexMask;
+};
+
+uint64_t perft(Board &board, int depth);
+uint64_t perft(Board &board, int depth, PerftTable &table);
+uint64_t parallelPerft(Board &board, int depth, int threads, int hashSizeMb);
+uint64_t divide(Board &board, int depth);
+bool runSuite(int maxDepth, int threads = 1, int hashSizeMb = 0);
+
+} // namespace perft
+
+#endif
@@ -1,70 +1,668 @@
 #include "search.h"
 #include "evaluate.h"
+#include "movepicker.h"
 #include <algorithm>
-#include <limits>
+#include <cmath>
+#include <cstdlib>
+#include <sstream>
+#include <thread>
 
-Searcher::Searcher() : bestMove(-1, -1, -1), board("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1") {}
+// Counting statistics costs a little at every node, so release builds can leave it out
+#ifdef SEARCH_STATS
+#define STAT(statement) statement
+#else
+#define STAT(statement)
+#endif
 
-Move Searcher::getBestMove(Board _board) {
-    bestMove = Move(-1, -1, -1);
-    board = _board;
-    negamax(6, -std::numeric_limits<int>::max(), std::numeric_limits<int>::max());
-    return bestMove;
+// Mate scores are stored relative to the position rather than the root so they stay valid at any ply
+static int scoreToTT(int score, int ply) {
+    if (score > MATE_SCORE - 1000) {
+        return score + ply;
+    }
+    if (score < -MATE_SCORE + 1000) {
+        return score - ply;
+    }
+    return score;
 }
 
-int Searcher::negamax(int depth, int alpha, int beta, bool updateBestMove) {
-    std::vector<Move> moves = board.getMoves();
-    std::sort(moves.begin(), moves.end(), std::greater<>());
-    if (moves.size() == 0 || board.getGameStatus()) {
-        return evaluate::evaluatePosition(board, depth);
+static int scoreFromTT(int score, int ply) {
+    if (score > MATE_SCORE - 1000) {
+        return score - ply;
     }
-    if (depth <= 0) {
-        if (!moves[0].isCapture() && !moves[0].isPromotion()) {
-            return evaluate::evaluatePosition(board);
+    if (score < -MATE_SCORE + 1000) {
+        return score + ply;
+    }
+    return score;
+}
+
+#define HISTORY_MAX 16384
+// History scores are divided by this between searches, so that they still order moves but adapt to the new position
+#define HISTORY_AGING_DIVISOR 2
+
+// Moves the history score towards the bonus so it stays within +-HISTORY_MAX
+static void updateHistory(int &entry, int bonus) { entry += bonus - entry * std::abs(bonus) / HISTORY_MAX; }
+
+#define INFINITE_SCORE 1000000000
+#define ASPIRATION_MIN_DEPTH 5
+#define ASPIRATION_WINDOW 25
+#define NULL_MOVE_MIN_DEPTH 3
+#define LMR_MIN_DEPTH 3
+#define LMR_MIN_MOVES 3
+
+// Late move reductions grow with the logarithms of both the remaining depth and the number of moves already searched
+static std::array<std::array<int, 64>, MAX_DEPTH + 1> calculateReductions() {
+    std::array<std::array<int, 64>, MAX_DEPTH + 1> table = {};
+    for (int depth = 1; depth <= MAX_DEPTH; depth++) {
+        for (int moves = 1; moves < 64; moves++) {
+            table[depth][moves] = 0.75 + std::log(depth) * std::log(moves) / 2.25;
+        }
+    }
+    return table;
+}
+
+static const std::array<std::array<int, 64>, MAX_DEPTH + 1> reductions = calculateReductions();
+
+Searcher::Searcher()
+    : transpositionTable(DEFAULT_HASH_MB), softTimeLimit(0), hardTimeLimit(0), ponderhitTime(0), pondering(false),
+      stopped(false),
+      stopRequested(false), isPrepared(false), reportedNodes(0), previousIterationNodes(0) {
+    setThreads(1);
+}
+
+void Searcher::setHashSize(int sizeMb) { transpositionTable.resize(sizeMb); }
+
+void Searcher::newGame() {
+    transpositionTable.clear();
+    for (std::unique_ptr<SearchWorker> &worker : workers) {
+        worker->newGame();
+    }
+}
+
+void Searcher::setThreads(int numThreads) {
+    workers.clear();
+    for (int i = 0; i < std::max(numThreads, 1); i++) {
+        workers.push_back(std::make_unique<SearchWorker>(*this, i));
+    }
+}
+
+void Searcher::setParameters(SearchParameters _parameters) { parameters = _parameters; }
+
+const SearchParameters &Searcher::getParameters() { return parameters; }
+
+void Searcher::setInfoCallback(std::function<void(const SearchInfo &)> callback) { infoCallback = callback; }
+
+void Searcher::prepare(const SearchLimits &_limits) {
+    stopRequested = false;
+    startTime = std::chrono::steady_clock::now();
+    ponderhitTime = 0;
+    pondering = _limits.ponder;
+    isPrepared = true;
+}
+
+void Searcher::stop() { stopRequested = true; }
+
+// The opponent played the move being pondered on, so the search carries on as a normal timed search from now
+void Searcher::ponderhit() {
+    // Before pondering is cleared, so the search never checks the limits against the wrong start
+    ponderhitTime = elapsedTime();
+    pondering = false;
+}
+
+int Searcher::getCompletedDepth() { return workers[0]->getCompletedDepth(); }
+
+int Searcher::getScore() { return workers[0]->getScore(); }
+
+std::vector<Move> Searcher::getPrincipalVariation() { return workers[0]->getPrincipalVariation(); }
+
+Move Searcher::getPonderMove() {
+    std::vector<Move> principalVariation = getPrincipalVariation();
+    return principalVariation.size() >= 2 ? principalVariation[1] : Move(0, 0, 0);
+}
+
+uint64_t Searcher::getNodes() {
+    uint64_t total = 0;
+    for (std::unique_ptr<SearchWorker> &worker : workers) {
+        total += worker->getNodes();
+    }
+    return total;
+}
+
+SearchStats Searcher::getStats() {
+    SearchStats total;
+    for (std::unique_ptr<SearchWorker> &worker : workers) {
+        total.add(worker->getStats());
+    }
+    return total;
+}
+
+Move Searcher::getBestMove(Board board, SearchLimits _limits) {
+    if (!isPrepared) {
+        prepare(_limits);
+    }
+    isPrepared = false;
+    limits = _limits;
+    allocateTime(board.getIsWhiteTurn());
+    stopped = false;
+    reportedNodes = 0;
+    previousIterationNodes = 0;
+    reportedStats = SearchStats();
+    transpositionTable.newSearch();
+    // Otherwise a helper that hasn't started yet would still report the previous search's counts
+    for (std::unique_ptr<SearchWorker> &worker : workers) {
+        worker->resetCounts();
+    }
+
+    std::vector<std::thread> helpers;
+    for (size_t i = 1; i < workers.size(); i++) {
+        helpers.emplace_back(&SearchWorker::search, workers[i].get(), std::cref(board));
+    }
+    workers[0]->search(board);
+
+    // Helper threads keep searching until the main thread has finished
+    stopped = true;
+    for (std::thread &helper : helpers) {
+        helper.join();
+    }
+    return workers[0]->getBestMove();
+}
+
+void Searcher::allocateTime(bool isWhiteTurn) {
+    softTimeLimit = 0;
+    hardTimeLimit = 0;
+    if (limits.moveTime) {
+        softTimeLimit = limits.moveTime;
+        hardTimeLimit = limits.moveTime;
+        return;
+    }
+    int timeLeft = isWhiteTurn ? limits.whiteTime : limits.blackTime;
+    int increment = isWhiteTurn ? limits.whiteIncrement : limits.blackIncrement;
+    if (!timeLeft) {
+        return;
+    }
+    int movesToGo = limits.movesToGo ? limits.movesToGo : 30;
+    // Keep a small margin so communication overhead never loses on time
+    int maxTime = std::max(timeLeft - 50, 1);
+    hardTimeLimit = std::min(timeLeft / movesToGo + increment * 3 / 4, maxTime);
+    softTimeLimit = std::max(hardTimeLimit / 2, 1);
+}
+
+int Searcher::elapsedTime() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+// Time counted against the limits, which excludes any time spent pondering
+int Searcher::timeUsed() { return elapsedTime() - ponderhitTime; }
+
+bool Searcher::isSoftTimeLimitReached() { return !pondering && softTimeLimit && timeUsed() >= softTimeLimit; }
+
+void Searcher::checkLimits() {
+    if (stopRequested || (limits.nodes && getNodes() >= limits.nodes) ||
+        (!pondering && hardTimeLimit && timeUsed() >= hardTimeLimit)) {
+        stopped = true;
+    }
+}
+
+void Searcher::reportIteration() {
+    if (!infoCallback) {
+        return;
+    }
+    SearchWorker &worker = *workers[0];
+    uint64_t nodes = getNodes();
+    uint64_t iterationNodes = nodes - reportedNodes;
+    double ebf = previousIterationNodes ? (double)iterationNodes / previousIterationNodes : 0;
+    reportedNodes = nodes;
+    previousIterationNodes = iterationNodes;
+    SearchStats stats = getStats();
+    SearchStats iterationStats = stats;
+    iterationStats.subtract(reportedStats);
+    reportedStats = stats;
+    infoCallback(SearchInfo(worker.getCompletedDepth(), worker.getScore(), nodes, iterationNodes, ebf, elapsedTime(),
+                            transpositionTable.hashfull(), worker.getPrincipalVariation(), stats, iterationStats));
+}
+
+void SearchStats::add(const SearchStats &other) {
+    qNodes += other.qNodes;
+    betaCutoffs += other.betaCutoffs;
+    firstMoveCutoffs += other.firstMoveCutoffs;
+    ttProbes += other.ttProbes;
+    ttHits += other.ttHits;
+    nullMoveSearches += other.nullMoveSearches;
+    nullMoveCutoffs += other.nullMoveCutoffs;
+    reducedSearches += other.reducedSearches;
+    reSearches += other.reSearches;
+    pvsReSearches += other.pvsReSearches;
+    aspirationFails += other.aspirationFails;
+    reverseFutilityPrunes += other.reverseFutilityPrunes;
+    futilityPrunes += other.futilityPrunes;
+    deltaPrunes += other.deltaPrunes;
+    selDepth = std::max(selDepth, other.selDepth);
+}
+
+void SearchStats::subtract(const SearchStats &other) {
+    qNodes -= other.qNodes;
+    betaCutoffs -= other.betaCutoffs;
+    firstMoveCutoffs -= other.firstMoveCutoffs;
+    ttProbes -= other.ttProbes;
+    ttHits -= other.ttHits;
+    nullMoveSearches -= other.nullMoveSearches;
+    nullMoveCutoffs -= other.nullMoveCutoffs;
+    reducedSearches -= other.reducedSearches;
+    reSearches -= other.reSearches;
+    pvsReSearches -= other.pvsReSearches;
+    aspirationFails -= other.aspirationFails;
+    reverseFutilityPrunes -= other.reverseFutilityPrunes;
+    futilityPrunes -= other.futilityPrunes;
+    deltaPrunes -= other.deltaPrunes;
+}
+
+std::string formatStatsJson(const SearchInfo &info) {
+    const SearchStats &stats = info.iterationStats;
+    std::ostringstream line;
+    line << "{\"depth\":" << info.depth << ",\"seldepth\":" << stats.selDepth << ",\"score\":" << info.score
+         << ",\"time\":" << info.time << ",\"nodes\":" << info.nodes
+         << ",\"iterationNodes\":" << info.iterationNodes << ",\"ebf\":" << info.ebf << ",\"qnodes\":" << stats.qNodes
+         << ",\"betaCutoffs\":" << stats.betaCutoffs << ",\"firstMoveCutoffRate\":"
+         << (stats.betaCutoffs ? (double)stats.firstMoveCutoffs / stats.betaCutoffs : 0)
+         << ",\"ttProbes\":" << stats.ttProbes << ",\"ttHits\":" << stats.ttHits
+         << ",\"nullMoveSearches\":" << stats.nullMoveSearches << ",\"nullMoveCutoffs\":" << stats.nullMoveCutoffs
+         << ",\"reducedSearches\":" << stats.reducedSearches << ",\"reSearches\":" << stats.reSearches
+         << ",\"pvsReSearches\":" << stats.pvsReSearches << ",\"aspirationFails\":" << stats.aspirationFails
+         << ",\"reverseFutilityPrunes\":" << stats.reverseFutilityPrunes
+         << ",\"futilityPrunes\":" << stats.futilityPrunes << ",\"deltaPrunes\":" << stats.deltaPrunes << "}";
+    return line.str();
+}
+
+SearchWorker::SearchWorker(Searcher &_searcher, int _id)
+    : searcher(_searcher), id(_id), board("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1"),
+      bestMove(-1, -1, -1), completedDepth(0), score(0), nodes(0), previousPvLength(0), expectedRootHash(0) {
+    clearHeuristics();
+}
+
+Move SearchWorker::getBestMove() { return bestMove; }
+
+int SearchWorker::getCompletedDepth() { return completedDepth; }
+
+int SearchWorker::getScore() { return score; }
+
+std::vector<Move> SearchWorker::getPrincipalVariation() {
+    return std::vector<Move>(previousPv.begin(), previousPv.begin() + previousPvLength);
+}
+
+uint64_t SearchWorker::getNodes() { return nodes.load(std::memory_order_relaxed); }
+
+SearchStats SearchWorker::getStats() {
+    std::lock_guard<std::mutex> lock(statsMutex);
+    return publishedStats;
+}
+
+void SearchWorker::publishStats() {
+    std::lock_guard<std::mutex> lock(statsMutex);
+    publishedStats = stats;
+}
+
+// Only this worker writes its node count, so a relaxed load and store avoids a locked increment
+void SearchWorker::countNode() {
+    uint64_t count = nodes.load(std::memory_order_relaxed) + 1;
+    nodes.store(count, std::memory_order_relaxed);
+    // The main thread checks the limits every 2048 nodes, but not during the first iteration so there is always a
+    // move to play
+    if (id == 0 && (count & 2047) == 0 && completedDepth) {
+        searcher.checkLimits();
+    }
+}
+
+void SearchWorker::clearHeuristics() {
+    for (std::array<Move, 2> &killers : killerMoves) {
+        killers.fill(Move(0, 0, 0));
+    }
+    for (std::array<std::array<int, 64>, 64> &colourHistory : history) {
+        for (std::array<int, 64> &startHistory : colourHistory) {
+            startHistory.fill(0);
+        }
+    }
+    for (std::array<Move, 64> &startCounterMoves : counterMoves) {
+        startCounterMoves.fill(Move(0, 0, 0));
+    }
+    moveStack.fill(Move(0, 0, 0));
+}
+
+// Killers are indexed by ply, so they belong to the previous root, but history and counter moves still apply
+void SearchWorker::ageHeuristics() {
+    for (std::array<Move, 2> &killers : killerMoves) {
+        killers.fill(Move(0, 0, 0));
+    }
+    for (std::array<std::array<int, 64>, 64> &colourHistory : history) {
+        for (std::array<int, 64> &startHistory : colourHistory) {
+            for (int &entry : startHistory) {
+                entry /= HISTORY_AGING_DIVISOR;
+            }
+        }
+    }
+    moveStack.fill(Move(0, 0, 0));
+}
+
+void SearchWorker::newGame() {
+    clearHeuristics();
+    previousPvLength = 0;
+    expectedRootHash = 0;
+}
+
+// When the game went the way the last search's principal variation predicted, the rest of it is searched first
+void SearchWorker::reusePrincipalVariation() {
+    if (previousPvLength > 2 && board.getHash() == expectedRootHash) {
+        std::copy(previousPv.begin() + 2, previousPv.begin() + previousPvLength, previousPv.begin());
+        previousPvLength -= 2;
+    } else {
+        previousPvLength = 0;
+    }
+}
+
+// Rewards a quiet move that caused a beta cutoff and penalises the quiet moves searched before it
+void SearchWorker::updateHeuristics(Move move, MoveList &quietsSearched, int depth, int ply) {
+    if (move != killerMoves[ply][0]) {
+        killerMoves[ply][1] = killerMoves[ply][0];
+        killerMoves[ply][0] = move;
+    }
+    if (ply > 0) {
+        counterMoves[moveStack[ply - 1].getStart()][moveStack[ply - 1].getDestination()] = move;
+    }
+
+    int colour = board.getIsWhiteTurn() ? 0 : 1;
+    int bonus = std::min(depth * depth, HISTORY_MAX);
+    updateHistory(history[colour][move.getStart()][move.getDestination()], bonus);
+    for (Move quiet : quietsSearched) {
+        updateHistory(history[colour][quiet.getStart()][quiet.getDestination()], -bonus);
+    }
+}
+
+void SearchWorker::resetCounts() {
+    nodes.store(0, std::memory_order_relaxed);
+    stats = SearchStats();
+    publishStats();
+}
+
+void SearchWorker::search(const Board &rootBoard) {
+    board = rootBoard;
+    completedDepth = 0;
+    score = 0;
+    reusePrincipalVariation();
+    ageHeuristics();
+
+    MoveList rootMoves;
+    board.generateMoves(rootMoves);
+    bestMove = rootMoves.empty() ? Move(-1, -1, -1) : rootMoves[0];
+
+    // Iterative deepening, keeping the best move of the last iteration that was searched to completion
+    for (int depth = 1; depth <= std::min(searcher.limits.depth, MAX_DEPTH); depth++) {
+        // Odd numbered helpers search one ply deeper so the threads work on different parts of the tree
+        int searchDepth = std::min(depth + (id & 1), MAX_DEPTH);
+        int value = aspirationSearch(searchDepth);
+        if (searcher.stopped.load(std::memory_order_relaxed)) {
+            break;
+        }
+        score = value;
+        std::copy(pvTable[0].begin(), pvTable[0].begin() + pvLength[0], previousPv.begin());
+        previousPvLength = pvLength[0];
+        if (previousPvLength) {
+            bestMove = previousPv[0];
+        }
+        completedDepth = searchDepth;
+        publishStats();
+        if (id != 0) {
+            continue;
+        }
+        searcher.reportIteration();
+        // Another iteration will take longer than all the previous ones, so don't start one we can't finish
+        if (searcher.isSoftTimeLimitReached()) {
+            break;
+        }
+    }
+
+    // Include the work done in an interrupted iteration
+    publishStats();
+
+    // The board is back at the root, as an interrupted search still unmakes its moves on the way out
+    expectedRootHash = 0;
+    if (previousPvLength > 2) {
+        board.makeMove(previousPv[0]);
+        board.makeMove(previousPv[1]);
+        expectedRootHash = board.getHash();
+        board.unmakeMove();
+        board.unmakeMove();
+    }
+}
+
+/* Searches the root with a narrow window around the previous iteration's score, which gives more cutoffs than a full
+ * window. When the score falls outside the window the search is repeated with a window twice as wide on that side. */
+int SearchWorker::aspirationSearch(int depth) {
+    int delta = ASPIRATION_WINDOW;
+    int alpha = -INFINITE_SCORE;
+    int beta = INFINITE_SCORE;
+    if (depth >= ASPIRATION_MIN_DEPTH) {
+        alpha = std::max(score - delta, -INFINITE_SCORE);
+        beta = std::min(score + delta, INFINITE_SCORE);
+    }
+
+    while (true) {
+        int value = negamax(depth, 0, alpha, beta);
+        if (searcher.stopped.load(std::memory_order_relaxed)) {
+            return 0;
+        }
+        delta = std::min(delta * 2, INFINITE_SCORE);
+        if (value <= alpha) {
+            alpha = std::max(value - delta, -INFINITE_SCORE);
+        } else if (value >= beta) {
+            beta = std::min(value + delta, INFINITE_SCORE);
         } else {
-            // return evaluate::evaluatePosition(board);
-            return qSearch(depth, alpha, beta);
+            return value;
         }
+        STAT(stats.aspirationFails++);
     }
-    int value = -1000000000;
-    for (Move move : moves) {
+}
+
+int SearchWorker::negamax(int depth, int ply, int alpha, int beta) {
+    pvLength[ply] = ply;
+    if (depth <= 0) {
+        return qSearch(ply, alpha, beta);
+    }
+    countNode();
+    stats.selDepth = std::max(stats.selDepth, ply);
+    if (searcher.stopped.load(std::memory_order_relaxed)) {
+        return 0;
+    }
+    if (ply > 0 && board.isDraw(ply)) {
+        return 0;
+    }
+
+    // Principal variation nodes are searched with an open window, everything else with a null window
+    bool isPvNode = beta - alpha > 1;
+    followsPreviousPv[ply] = ply == 0 || (followsPreviousPv[ply - 1] && ply <= previousPvLength &&
+                                          moveStack[ply - 1] == previousPv[ply - 1]);
+
+    // Cutoffs from the table would cut the principal variation short, so they are only taken at null window nodes
+    TTEntry entry;
+    bool ttHit = searcher.transpositionTable.probe(board.getHash(), entry);
+    STAT(stats.ttProbes++);
+    STAT(stats.ttHits += ttHit);
+    if (ttHit && !isPvNode && ply > 0 && entry.depth >= depth) {
+        int ttScore = scoreFromTT(entry.score, ply);
+        if (entry.bound == BOUND_EXACT || (entry.bound == BOUND_LOWER && ttScore >= beta) ||
+            (entry.bound == BOUND_UPPER && ttScore <= alpha)) {
+            return ttScore;
+        }
+    }
+
+    const SearchParameters &parameters = searcher.parameters;
+    bool inCheck = board.isInCheck();
+    int staticEval = inCheck ? -INFINITE_SCORE : evaluate::staticEvaluation(board);
+
+    // Reverse futility pruning: close to the horizon, a static evaluation far enough above beta is assumed to hold
+    if (!isPvNode && !inCheck && depth <= parameters.reverseFutilityDepth && beta < MATE_SCORE - 1000 &&
+        staticEval - parameters.reverseFutilityMargin * depth >= beta) {
+        STAT(stats.reverseFutilityPrunes++);
+        return staticEval;
+    }
+
+    /* Null move pruning: if passing the turn still fails high after a reduced search, a real move almost certainly
+     * would too. It is skipped in check, after another null move, and without pieces other than pawns, where zugzwang
+     * makes passing better than any legal move. */
+    if (!isPvNode && ply > 0 && depth >= NULL_MOVE_MIN_DEPTH && !inCheck && moveStack[ply - 1] != Move(0, 0, 0) &&
+        beta < MATE_SCORE - 1000 && board.hasNonPawnMaterial() && staticEval >= beta) {
+        int reduction = 3 + depth / 4;
+        moveStack[ply] = Move(0, 0, 0);
+        board.makeNullMove();
+        STAT(stats.nullMoveSearches++);
+        int nullValue = -negamax(depth - 1 - reduction, ply + 1, -beta, -beta + 1);
+        board.unmakeMove();
+        if (searcher.stopped.load(std::memory_order_relaxed)) {
+            return 0;
+        }
+        if (nullValue >= beta) {
+            STAT(stats.nullMoveCutoffs++);
+            // A mate found after passing isn't a proven mate
+            return nullValue > MATE_SCORE - 1000 ? beta : nullValue;
+        }
+    }
+
+    // Search the hash move first, or along the previous iteration's principal variation the move it played
+    uint16_t hashMove = ttHit ? entry.move : 0;
+    if (followsPreviousPv[ply] && ply < previousPvLength) {
+        hashMove = previousPv[ply].getValue();
+    }
+    Move counterMove = ply > 0 ? counterMoves[moveStack[ply - 1].getStart()][moveStack[ply - 1].getDestination()]
+                               : Move(0, 0, 0);
+    MovePicker picker(board, hashMove, killerMoves[ply], counterMove, history[board.getIsWhiteTurn() ? 0 : 1]);
+
+    // Futility pruning: near the horizon, quiet moves can't raise a static evaluation this far below alpha
+    bool isFutile = !isPvNode && !inCheck && depth <= parameters.futilityDepth && alpha > -MATE_SCORE + 1000 &&
+                    staticEval + parameters.futilityBaseMargin + parameters.futilityDepthMargin * depth <= alpha;
+
+    int originalAlpha = alpha;
+    int value = -INFINITE_SCORE;
+    Move nodeBestMove = Move(0, 0, 0);
+    MoveList quietsSearched;
+    int movesSearched = 0;
+    Move move;
+    while (picker.nextMove(move)) {
+        bool isQuiet = !move.isCapture() && !move.isPromotion();
+        moveStack[ply] = move;
         board.makeMove(move);
-        int newValue = -negamax(depth - 1, -beta, -alpha, false);
-        board.unmakeMove(move);
-        if (updateBestMove) {
-            /* std::cout << 7 - depth << ": " << move.getStart() << ", " << move.getDestination() << ": " << newValue
-                      << '\n'; */
+        // At least one move is searched so that pruning can't be mistaken for checkmate or stalemate
+        if (isFutile && isQuiet && movesSearched && !board.isInCheck()) {
+            board.unmakeMove();
+            STAT(stats.futilityPrunes++);
+            continue;
+        }
+
+        /* Principal variation search: moves after the first are expected to be worse, so they are only searched with
+         * a null window to prove they don't beat alpha, and again with the full window if they do. Late move
+         * reductions: quiet moves ordered late rarely turn out best, so their null window search is also shallower
+         * at first. */
+        int newValue;
+        if (!movesSearched) {
+            newValue = -negamax(depth - 1, ply + 1, -beta, -alpha);
+        } else {
+            int reduction = 0;
+            if (depth >= LMR_MIN_DEPTH && movesSearched >= LMR_MIN_MOVES && isQuiet && !inCheck &&
+                !board.isInCheck()) {
+                reduction = std::clamp(reductions[depth][std::min(movesSearched, 63)], 0, depth - 2);
+                STAT(stats.reducedSearches++);
+            }
+            newValue = -negamax(depth - 1 - reduction, ply + 1, -alpha - 1, -alpha);
+            if (reduction && newValue > alpha) {
+                STAT(stats.reSearches++);
+                newValue = -negamax(depth - 1, ply + 1, -alpha - 1, -alpha);
+            }
+            if (newValue > alpha && newValue < beta) {
+                STAT(stats.pvsReSearches++);
+                newValue = -negamax(depth - 1, ply + 1, -beta, -alpha);
+            }
+        }
+        board.unmakeMove();
+        movesSearched++;
+        if (searcher.stopped.load(std::memory_order_relaxed)) {
+            return 0;
         }
         if (newValue > value) {
             value = newValue;
-            if (updateBestMove) {
-                bestMove = move;
-            }
+            nodeBestMove = move;
+        }
+        if (value > alpha) {
+            alpha = value;
+            // The new best line is this move followed by the best line found after it
+            pvTable[ply][ply] = move;
+            std::copy(pvTable[ply + 1].begin() + ply + 1, pvTable[ply + 1].begin() + pvLength[ply + 1],
+                      pvTable[ply].begin() + ply + 1);
+            pvLength[ply] = pvLength[ply + 1];
         }
-        alpha = std::max(alpha, value);
         if (alpha >= beta) {
+            STAT(stats.betaCutoffs++);
+            STAT(stats.firstMoveCutoffs += movesSearched == 1);
+            if (isQuiet) {
+                updateHeuristics(move, quietsSearched, depth, ply);
+            }
             break;
         }
+        if (isQuiet) {
+            quietsSearched.push_back(move);
+        }
     }
+    if (!movesSearched) {
+        return inCheck ? -MATE_SCORE + ply : 0;
+    }
+
+    int bound = value <= originalAlpha ? BOUND_UPPER : value >= beta ? BOUND_LOWER : BOUND_EXACT;
+    searcher.transpositionTable.store(board.getHash(), nodeBestMove, depth, bound, scoreToTT(value, ply));
     return value;
 }
 
-int Searcher::qSearch(int depth, int alpha, int beta) {
-    int bestValue = evaluate::evaluatePosition(board, depth);
-    if (bestValue >= beta) {
-        return bestValue;
+int SearchWorker::qSearch(int ply, int alpha, int beta) {
+    pvLength[ply] = ply;
+    countNode();
+    STAT(stats.qNodes++);
+    stats.selDepth = std::max(stats.selDepth, ply);
+    if (searcher.stopped.load(std::memory_order_relaxed)) {
+        return 0;
+    }
+    if (board.isDraw(ply)) {
+        return 0;
+    }
+    if (ply >= MAX_PLY - 1) {
+        return evaluate::staticEvaluation(board);
     }
-    alpha = std::max(alpha, bestValue);
 
-    std::vector<Move> moves = board.getMoves();
-    std::sort(moves.begin(), moves.end(), std::greater<>());
-    for (Move move : moves) {
-        if (!move.isPromotion() && !move.isCapture()) {
-            break;
+    // In check every evasion is searched, so that mates are still found without generating quiet moves elsewhere
+    bool inCheck = board.isInCheck();
+    int bestValue = -MATE_SCORE + ply;
+    if (!inCheck) {
+        bestValue = evaluate::staticEvaluation(board);
+        if (bestValue >= beta) {
+            return bestValue;
         }
+        alpha = std::max(alpha, bestValue);
+    }
+
+    // Out of check the captures-only picker skips captures that lose material by static exchange evaluation
+    int colour = board.getIsWhiteTurn() ? 0 : 1;
+    MovePicker picker =
+        inCheck ? MovePicker(board, 0, killerMoves[ply], Move(0, 0, 0), history[colour]) : MovePicker(board);
+    Move move;
+    while (picker.nextMove(move)) {
+        // Delta pruning: skip captures that can't bring the evaluation back up to alpha even with a margin to spare
+        if (!inCheck && !move.isPromotion()) {
+            int victim = move.getFlags() == 5 ? 1 : board.getPiece(move.getDestination()) & 7;
+            if (bestValue + evaluate::pieceValues[victim - 1] + searcher.parameters.deltaMargin <= alpha) {
+                STAT(stats.deltaPrunes++);
+                continue;
+            }
+        }
+        moveStack[ply] = move;
         board.makeMove(move);
-        int value = -qSearch(depth - 1, -beta, -alpha);
-        board.unmakeMove(move);
+        int value = -qSearch(ply + 1, -beta, -alpha);
+        board.unmakeMove();
+        if (searcher.stopped.load(std::memory_order_relaxed)) {
+            return 0;
+        }
         if (value >= beta) {
             return value;
         }
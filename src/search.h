@@ -2,17 +2,223 @@
 #define SEARCH_H
 
 #include "board.h"
+#include "transposition.h"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
 
-class Searcher {
+#define MATE_SCORE 10000000
+#define MAX_DEPTH 64
+#define MAX_PLY 128
+#define DEFAULT_HASH_MB 16
+
+/* Times are in milliseconds and a value of 0 means no limit. If neither a move time nor a clock time for the side to
+ * move is given the search runs until the depth or node limit is reached or stop() is called. A ponder search ignores
+ * the time limits until ponderhit() is called. */
+struct SearchLimits {
+    int depth = MAX_DEPTH;
+    uint64_t nodes = 0;
+    int moveTime = 0;
+    int whiteTime = 0;
+    int blackTime = 0;
+    int whiteIncrement = 0;
+    int blackIncrement = 0;
+    int movesToGo = 0;
+    bool ponder = false;
+};
+
+/* What the search did, for tuning. Each thread counts its own and publishes a copy after every iteration. Counting is
+ * compiled out unless SEARCH_STATS is defined; without it every count except selDepth stays 0. */
+struct SearchStats {
+    uint64_t qNodes = 0;
+    // Cutoffs in the main search's move loop, and how many of them came from the first move searched
+    uint64_t betaCutoffs = 0;
+    uint64_t firstMoveCutoffs = 0;
+    uint64_t ttProbes = 0;
+    uint64_t ttHits = 0;
+    uint64_t nullMoveSearches = 0;
+    uint64_t nullMoveCutoffs = 0;
+    uint64_t reducedSearches = 0;
+    uint64_t reSearches = 0;
+    uint64_t pvsReSearches = 0;
+    uint64_t aspirationFails = 0;
+    uint64_t reverseFutilityPrunes = 0;
+    uint64_t futilityPrunes = 0;
+    uint64_t deltaPrunes = 0;
+    // Deepest ply reached, including quiescence search. Always tracked, as UCI reports it as seldepth.
+    int selDepth = 0;
+
+    void add(const SearchStats &other);
+    // Removes the counts of an earlier copy, leaving selDepth as it is since it isn't a count
+    void subtract(const SearchStats &other);
+};
+
+// Progress reported after every completed iteration of the main search thread
+struct SearchInfo {
+    int depth;
+    int score;
+    uint64_t nodes;
+    // Nodes searched by all threads since the previous report
+    uint64_t iterationNodes;
+    // Effective branching factor, iterationNodes over the previous iteration's, or 0 after the first iteration
+    double ebf;
+    int time;
+    // Permille of the transposition table in use
+    int hashfull;
+    std::vector<Move> principalVariation;
+    // Totals over all threads since the search started, as of their last completed iterations
+    SearchStats stats;
+    // The part of stats counted since the previous report
+    SearchStats iterationStats;
+};
+
+/* One line of JSON with the depth, score, nodes, branching factor, time and statistics of an iteration. The nodes
+ * and time are totals for the search; the counters after them only cover this iteration. */
+std::string formatStatsJson(const SearchInfo &info);
+
+/* Pruning margins in centipawns, so they can be tuned without rebuilding. Each technique only applies up to the given
+ * remaining depth. */
+struct SearchParameters {
+    // A node fails high without searching if the static evaluation beats beta by this much per ply of depth
+    int reverseFutilityDepth = 6;
+    int reverseFutilityMargin = 80;
+    // Quiet moves are skipped if the static evaluation plus this base and per ply margin can't reach alpha
+    int futilityDepth = 3;
+    int futilityBaseMargin = 100;
+    int futilityDepthMargin = 100;
+    // Captures in quiescence search are skipped if winning the captured piece plus this margin can't reach alpha
+    int deltaMargin = 200;
+};
+
+class Searcher;
+
+// The board and search state of a single search thread.
+class SearchWorker {
   public:
-    Searcher();
-    Move getBestMove(Board board);
+    SearchWorker(Searcher &searcher, int id);
+    // Zeroes the node count and statistics, before any thread of the next search starts
+    void resetCounts();
+    void search(const Board &rootBoard);
+    void newGame();
+
+    Move getBestMove();
+    int getCompletedDepth();
+    int getScore();
+    std::vector<Move> getPrincipalVariation();
+    uint64_t getNodes();
+    SearchStats getStats();
 
   private:
+    Searcher &searcher;
+    int id;
     Board board;
     Move bestMove;
-    int negamax(int depth, int alpha, int beta, bool updateBestMove = true);
-    int qSearch(int depth, int alpha, int beta);
+    int completedDepth;
+    int score;
+    std::atomic<uint64_t> nodes;
+    SearchStats stats;
+    // Copy of stats for other threads to read while this one is still counting
+    std::mutex statsMutex;
+    SearchStats publishedStats;
+
+    // Move ordering heuristics
+    std::array<std::array<Move, 2>, MAX_PLY> killerMoves;
+    std::array<std::array<std::array<int, 64>, 64>, 2> history;
+    std::array<std::array<Move, 64>, 64> counterMoves;
+    std::array<Move, MAX_PLY> moveStack;
+
+    /* Triangular principal variation table: row ply holds the best line found from that ply, ending at
+     * pvLength[ply]. The line of the last completed iteration is searched first in the next one. */
+    std::array<std::array<Move, MAX_PLY>, MAX_PLY> pvTable;
+    std::array<int, MAX_PLY> pvLength;
+    std::array<Move, MAX_PLY> previousPv;
+    int previousPvLength;
+    // Whether the moves leading to each ply are the start of the previous principal variation
+    std::array<bool, MAX_PLY> followsPreviousPv;
+    /* Position reached by the first two moves of the last search's principal variation. If the next search starts
+     * there, the rest of that line is searched first. */
+    uint64_t expectedRootHash;
+
+    void countNode();
+    void publishStats();
+    void clearHeuristics();
+    void ageHeuristics();
+    void reusePrincipalVariation();
+    void updateHeuristics(Move move, MoveList &quietsSearched, int depth, int ply);
+    int aspirationSearch(int depth);
+    int negamax(int depth, int ply, int alpha, int beta);
+    int qSearch(int ply, int alpha, int beta);
+};
+
+/* Lazy SMP: every thread searches the same position with its own board, sharing results only through the
+ * transposition table. The first worker runs on the calling thread, manages time and provides the best move.
+ * The transposition table and move ordering heuristics are kept from one search to the next, so consecutive moves of a
+ * game start partly warm, until newGame() is called. */
+class Searcher {
+  public:
+    Searcher();
+    Move getBestMove(Board board, SearchLimits limits);
+    /* Clears any earlier stop(), starts the clock and sets whether the next search ponders. getBestMove does this
+     * itself unless it has already been done, so a caller that searches on another thread calls it before starting
+     * that thread. A stop() or ponderhit() sent before the thread reaches getBestMove then still applies to the
+     * search. */
+    void prepare(const SearchLimits &limits);
+    // Forgets everything learned from the previous game's positions
+    void newGame();
+    void setHashSize(int sizeMb);
+    void setThreads(int numThreads);
+    void setParameters(SearchParameters parameters);
+    const SearchParameters &getParameters();
+    // Called on the searching thread, so it must not call back into the searcher other than stop()
+    void setInfoCallback(std::function<void(const SearchInfo &)> callback);
+    void stop();
+    void ponderhit();
+
+    int getCompletedDepth();
+    int getScore();
+    std::vector<Move> getPrincipalVariation();
+    // The reply expected to the best move, or a null move if the principal variation doesn't reach that far
+    Move getPonderMove();
+    uint64_t getNodes();
+    SearchStats getStats();
+
+  private:
+    friend class SearchWorker;
+
+    TranspositionTable transpositionTable;
+    std::vector<std::unique_ptr<SearchWorker>> workers;
+
+    SearchLimits limits;
+    SearchParameters parameters;
+    std::function<void(const SearchInfo &)> infoCallback;
+    // Set by prepare(), so ponderhit() on the caller's thread never reads it while the search is writing it
+    std::chrono::steady_clock::time_point startTime;
+    int softTimeLimit;
+    int hardTimeLimit;
+    /* Milliseconds after startTime that ponderhit() arrived. The clock only starts running once the predicted move is
+     * played, so the time limits count from there. */
+    std::atomic<int> ponderhitTime;
+    std::atomic<bool> pondering;
+    std::atomic<bool> stopped;
+    std::atomic<bool> stopRequested;
+    // Set by prepare() on the caller's thread before the searching thread is started
+    bool isPrepared;
+    // Node counts at and between the last two reports, for the per iteration figures
+    uint64_t reportedNodes;
+    uint64_t previousIterationNodes;
+    SearchStats reportedStats;
+
+    void allocateTime(bool isWhiteTurn);
+    int elapsedTime();
+    int timeUsed();
+    bool isSoftTimeLimitReached();
+    void checkLimits();
+    void reportIteration();
 };
 
 #endif
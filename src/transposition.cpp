@@ -0,0 +1,94 @@
+#include "transposition.h"
+
+static uint64_t packEntry(uint16_t move, int depth, int bound, int generation, int score) {
+    return (uint64_t)move | (uint64_t)(depth & 0xff) << 16 | (uint64_t)(bound & 3) << 24 |
+           (uint64_t)(generation & (TT_GENERATIONS - 1)) << 26 | (uint64_t)(uint32_t)score << 32;
+}
+
+static TTEntry unpackEntry(uint64_t hash, uint64_t data) {
+    return TTEntry(hash, (int32_t)(data >> 32), (uint16_t)data, (uint8_t)(data >> 16), (uint8_t)(data >> 24 & 3),
+                   (uint8_t)(data >> 26 & (TT_GENERATIONS - 1)));
+}
+
+TranspositionTable::TranspositionTable(int sizeMb) : generation(0) { resize(sizeMb); }
+
+void TranspositionTable::resize(int sizeMb) {
+    uint64_t numBuckets = tableCapacity(sizeMb, sizeof(TTBucket));
+    buckets = std::vector<TTBucket>(numBuckets);
+    bucketMask = numBuckets - 1;
+    clear();
+}
+
+void TranspositionTable::clear() {
+    for (TTBucket &bucket : buckets) {
+        for (LocklessSlot &slot : bucket.slots) {
+            slot.store(0, 0);
+        }
+    }
+    generation = 0;
+}
+
+void TranspositionTable::newSearch() { generation = (generation + 1) % TT_GENERATIONS; }
+
+bool TranspositionTable::probe(uint64_t hash, TTEntry &entry) {
+    TTBucket &bucket = buckets[hash & bucketMask];
+    for (LocklessSlot &slot : bucket.slots) {
+        uint64_t data;
+        if (slot.load(data) == hash) {
+            entry = unpackEntry(hash, data);
+            return true;
+        }
+    }
+    return false;
+}
+
+void TranspositionTable::store(uint64_t hash, Move move, int depth, int bound, int score) {
+    TTBucket &bucket = buckets[hash & bucketMask];
+
+    /* Overwrite the entry for the same position if there is one, otherwise the least valuable entry in the bucket.
+     * Every search since an entry was stored counts against it like several plies of depth, so deep entries from
+     * earlier moves don't fill the table forever. */
+    LocklessSlot *replace = nullptr;
+    TTEntry replaceEntry{};
+    int replaceValue = 0;
+    for (LocklessSlot &slot : bucket.slots) {
+        uint64_t data;
+        uint64_t key = slot.load(data);
+        TTEntry candidate = unpackEntry(key, data);
+        if (candidate.key == hash) {
+            replace = &slot;
+            replaceEntry = candidate;
+            break;
+        }
+        int age = (generation - candidate.generation) & (TT_GENERATIONS - 1);
+        int value = candidate.depth - age * 8;
+        if (!replace || value < replaceValue) {
+            replace = &slot;
+            replaceEntry = candidate;
+            replaceValue = value;
+        }
+    }
+
+    uint16_t moveValue = move.getValue();
+    // Keep the old best move if this search did not produce one
+    if (!moveValue && replaceEntry.key == hash) {
+        moveValue = replaceEntry.move;
+    }
+    uint64_t data = packEntry(moveValue, depth, bound, generation, score);
+    replace->store(hash, data);
+}
+
+/* Permille of the slots used by the current search, estimated from the first thousand or so like UCI engines usually
+ * do. Entries from earlier searches are free to be replaced, so they don't count. */
+int TranspositionTable::hashfull() {
+    int used = 0;
+    int sampled = 0;
+    for (int i = 0; i < (int)buckets.size() && sampled < 1000; i++) {
+        for (LocklessSlot &slot : buckets[i].slots) {
+            uint64_t data = slot.data.load(std::memory_order_relaxed);
+            used += data != 0 && unpackEntry(0, data).generation == generation;
+            sampled++;
+        }
+    }
+    return used * 1000 / sampled;
+}
@@ -0,0 +1,49 @@
+#ifndef TRANSPOSITION_H
+#define TRANSPOSITION_H
+
+#include "board.h"
+#include "hashtable.h"
+#include <cstdint>
+#include <vector>
+
+#define BOUND_EXACT 0
+#define BOUND_LOWER 1
+#define BOUND_UPPER 2
+
+// Generations wrap around within the bits left over next to the bound
+#define TT_GENERATIONS 64
+
+struct TTEntry {
+    uint64_t key;
+    int32_t score;
+    uint16_t move;
+    uint8_t depth;
+    uint8_t bound;
+    // Search that last stored the entry, so entries left over from earlier moves are replaced first
+    uint8_t generation;
+};
+
+// The table is shared between search threads without locking. Slots are grouped so each bucket fills one cache line.
+struct alignas(64) TTBucket {
+    LocklessSlot slots[4];
+};
+
+class TranspositionTable {
+  public:
+    TranspositionTable(int sizeMb);
+
+    void resize(int sizeMb);
+    void clear();
+    // Called at the start of every search, which ages the entries stored by previous ones
+    void newSearch();
+    bool probe(uint64_t hash, TTEntry &entry);
+    void store(uint64_t hash, Move move, int depth, int bound, int score);
+    int hashfull();
+
+  private:
+    std::vector<TTBucket> buckets;
+    uint64_t bucketMask;
+    uint8_t generation;
+};
+
+#endif
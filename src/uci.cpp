@@ -0,0 +1,329 @@
+#include "attacks.h"
+#include "bench.h"
+#include "board.h"
+#include "perft.h"
+#include "search.h"
+#include <array>
+#include <condition_variable>
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#define ENGINE_NAME "chess-engine"
+#define STARTING_FEN "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1"
+#define MAX_HASH_MB 4096
+#define MAX_THREADS 256
+#define BENCH_DEPTH 10
+#define MAX_MARGIN 2000
+
+// A pruning margin of SearchParameters offered as a spin option, so it can be tuned without rebuilding
+struct ParameterOption {
+    const char *name;
+    int SearchParameters::*field;
+    int max;
+};
+
+const std::array<ParameterOption, 6> parameterOptions = {
+    ParameterOption("ReverseFutilityDepth", &SearchParameters::reverseFutilityDepth, MAX_DEPTH),
+    ParameterOption("ReverseFutilityMargin", &SearchParameters::reverseFutilityMargin, MAX_MARGIN),
+    ParameterOption("FutilityDepth", &SearchParameters::futilityDepth, MAX_DEPTH),
+    ParameterOption("FutilityBaseMargin", &SearchParameters::futilityBaseMargin, MAX_MARGIN),
+    ParameterOption("FutilityDepthMargin", &SearchParameters::futilityDepthMargin, MAX_MARGIN),
+    ParameterOption("DeltaMargin", &SearchParameters::deltaMargin, MAX_MARGIN),
+};
+
+/* Speaks the Universal Chess Interface over stdin and stdout. Searches run on their own thread so that stop,
+ * ponderhit and isready are still answered while the engine is thinking. Besides the protocol it understands the
+ * usual debugging commands: perft (the perft suite), go perft (divide on the current position) and bench. */
+class UciEngine {
+  public:
+    UciEngine() : board(STARTING_FEN), isInfinite(false), isPonderEnabled(false), failed(false), waitForStop(false) {
+        searcher.setInfoCallback([this](const SearchInfo &info) {
+            send(formatInfo(info));
+#ifdef SEARCH_STATS
+            // Kept off stdout so the statistics can be collected without confusing the GUI
+            std::cerr << formatStatsJson(info) << std::endl;
+#endif
+        });
+    }
+
+    void run() {
+        std::string line;
+        while (std::getline(std::cin, line) && execute(line)) {
+        }
+        stopSearch();
+    }
+
+    // Returns false on quit
+    bool execute(const std::string &line) {
+        std::istringstream stream(line);
+        std::string command;
+        stream >> command;
+
+        if (command == "uci") {
+            send("id name " ENGINE_NAME);
+            send("option name Hash type spin default " + std::to_string(DEFAULT_HASH_MB) + " min 1 max " +
+                 std::to_string(MAX_HASH_MB));
+            send("option name Threads type spin default 1 min 1 max " + std::to_string(MAX_THREADS));
+            send("option name Ponder type check default false");
+            send(std::string("option name SliderAttacks type combo default ") + attacks::getBackendName() +
+                 " var magic" + (attacks::isPextSupported() ? " var pext" : ""));
+            const SearchParameters defaults;
+            for (const ParameterOption &option : parameterOptions) {
+                send(std::string("option name ") + option.name + " type spin default " +
+                     std::to_string(defaults.*option.field) + " min 0 max " + std::to_string(option.max));
+            }
+            send("uciok");
+        } else if (command == "isready") {
+            send("readyok");
+        } else if (command == "setoption") {
+            setOption(stream);
+        } else if (command == "ucinewgame") {
+            stopSearch();
+            searcher.newGame();
+            board = Board(STARTING_FEN);
+        } else if (command == "position") {
+            stopSearch();
+            setPosition(stream);
+        } else if (command == "go") {
+            go(stream);
+        } else if (command == "stop") {
+            stopSearch();
+        } else if (command == "ponderhit") {
+            searcher.ponderhit();
+            // A timed search carries on by itself, an infinite one still waits for stop
+            if (!isInfinite) {
+                releaseBestMove();
+            }
+        } else if (command == "perft") {
+            // perft <depth> [threads] [hash MB]
+            int depth = 0, threads = 1, hashSizeMb = 0;
+            stream >> depth >> threads >> hashSizeMb;
+            stopSearch();
+            std::lock_guard<std::mutex> lock(outputMutex);
+            if (!perft::runSuite(std::max(depth, 1), std::max(threads, 1), std::max(hashSizeMb, 0))) {
+                failed = true;
+            }
+            std::cout << std::flush;
+        } else if (command == "bench") {
+            // bench [depth]
+            int depth = BENCH_DEPTH;
+            if (!(stream >> depth)) {
+                depth = BENCH_DEPTH;
+            }
+            stopSearch();
+            std::lock_guard<std::mutex> lock(outputMutex);
+            bench::searchBenchmark(depth);
+            std::cout << std::flush;
+        } else if (command == "quit") {
+            return false;
+        }
+        return true;
+    }
+
+    // Set when a perft count was wrong, so scripts and ctest see the failure in the exit code
+    bool hasFailed() const { return failed; }
+
+  private:
+    Board board;
+    Searcher searcher;
+    std::thread searchThread;
+    bool isInfinite;
+    // Set by the GUI's Ponder option. go ponder works either way, this only decides whether bestmove suggests a move.
+    bool isPonderEnabled;
+    bool failed;
+
+    // Infinite and ponder searches may only send their best move once the GUI allows it
+    std::mutex waitMutex;
+    std::condition_variable waitCondition;
+    bool waitForStop;
+
+    // Info lines come from the search thread while replies to commands come from this one
+    std::mutex outputMutex;
+
+    void send(const std::string &line) {
+        std::lock_guard<std::mutex> lock(outputMutex);
+        std::cout << line << std::endl;
+    }
+
+    static std::string formatInfo(const SearchInfo &info) {
+        std::ostringstream line;
+        line << "info depth " << info.depth;
+        if (info.stats.selDepth) {
+            line << " seldepth " << info.stats.selDepth;
+        }
+        line << " score ";
+        int distance = MATE_SCORE - std::abs(info.score);
+        if (distance < 1000) {
+            // Mate scores count plies, UCI counts moves
+            int moves = (distance + 1) / 2;
+            line << "mate " << (info.score > 0 ? moves : -moves);
+        } else {
+            line << "cp " << info.score;
+        }
+        uint64_t nps = info.nodes * 1000 / std::max(info.time, 1);
+        line << " nodes " << info.nodes << " nps " << nps << " time " << info.time << " hashfull " << info.hashfull;
+        line << " pv";
+        for (Move move : info.principalVariation) {
+            line << ' ' << move.toString();
+        }
+        return line.str();
+    }
+
+    void setOption(std::istringstream &stream) {
+        std::string token;
+        std::string name;
+        std::string value;
+        stream >> token;
+        while (stream >> token && token != "value") {
+            name += (name.empty() ? "" : " ") + token;
+        }
+        stream >> value;
+
+        stopSearch();
+        if (name == "Hash") {
+            searcher.setHashSize(std::clamp(atoi(value.c_str()), 1, MAX_HASH_MB));
+        } else if (name == "Threads") {
+            searcher.setThreads(std::clamp(atoi(value.c_str()), 1, MAX_THREADS));
+        } else if (name == "Ponder") {
+            isPonderEnabled = value == "true";
+        } else if (name == "SliderAttacks") {
+            attacks::setBackend(value == "pext" ? BACKEND_PEXT : BACKEND_MAGIC);
+        }
+        for (const ParameterOption &option : parameterOptions) {
+            if (name == option.name) {
+                SearchParameters parameters = searcher.getParameters();
+                parameters.*option.field = std::clamp(atoi(value.c_str()), 0, option.max);
+                searcher.setParameters(parameters);
+            }
+        }
+    }
+
+    // position (startpos | fen <fen>) [moves <move>...]
+    void setPosition(std::istringstream &stream) {
+        std::string token;
+        std::string fen;
+        stream >> token;
+        if (token == "startpos") {
+            fen = STARTING_FEN;
+            stream >> token;
+        } else if (token == "fen") {
+            while (stream >> token && token != "moves") {
+                fen += (fen.empty() ? "" : " ") + token;
+            }
+        } else {
+            return;
+        }
+        board = Board(fen);
+
+        while (stream >> token) {
+            MoveList moves;
+            board.generateMoves(moves);
+            bool isLegal = false;
+            for (Move move : moves) {
+                if (move.toString() == token) {
+                    board.makeMove(move);
+                    isLegal = true;
+                    break;
+                }
+            }
+            if (!isLegal) {
+                // The rest of the moves are ignored, so say where the position stops matching the GUI's
+                send("info string illegal move " + token + ", position set before it");
+                return;
+            }
+        }
+    }
+
+    void go(std::istringstream &stream) {
+        stopSearch();
+        SearchLimits limits;
+        isInfinite = false;
+        std::string token;
+        while (stream >> token) {
+            if (token == "perft") {
+                // Node counts per root move, for comparing move generation against another engine
+                int depth = 0;
+                stream >> depth;
+                std::lock_guard<std::mutex> lock(outputMutex);
+                perft::divide(board, std::max(depth, 1));
+                std::cout << std::flush;
+                return;
+            } else if (token == "depth") {
+                stream >> limits.depth;
+            } else if (token == "nodes") {
+                stream >> limits.nodes;
+            } else if (token == "movetime") {
+                stream >> limits.moveTime;
+            } else if (token == "wtime") {
+                stream >> limits.whiteTime;
+            } else if (token == "btime") {
+                stream >> limits.blackTime;
+            } else if (token == "winc") {
+                stream >> limits.whiteIncrement;
+            } else if (token == "binc") {
+                stream >> limits.blackIncrement;
+            } else if (token == "movestogo") {
+                stream >> limits.movesToGo;
+            } else if (token == "infinite") {
+                isInfinite = true;
+            } else if (token == "ponder") {
+                limits.ponder = true;
+            }
+        }
+
+        waitForStop = isInfinite || limits.ponder;
+        // Before the thread starts, so that a stop or ponderhit right after go isn't lost
+        searcher.prepare(limits);
+        searchThread = std::thread([this, limits, searchBoard = board]() mutable {
+            Move bestMove = searcher.getBestMove(searchBoard, limits);
+            {
+                std::unique_lock<std::mutex> lock(waitMutex);
+                waitCondition.wait(lock, [this] { return !waitForStop; });
+            }
+            MoveList moves;
+            searchBoard.generateMoves(moves);
+            if (moves.empty()) {
+                send("bestmove 0000");
+                return;
+            }
+            // Lets the GUI start a ponder search on the reply we expect
+            Move ponderMove = searcher.getPonderMove();
+            bool sendPonderMove = isPonderEnabled && ponderMove.getValue();
+            send("bestmove " + bestMove.toString() + (sendPonderMove ? " ponder " + ponderMove.toString() : ""));
+        });
+    }
+
+    void releaseBestMove() {
+        {
+            std::lock_guard<std::mutex> lock(waitMutex);
+            waitForStop = false;
+        }
+        waitCondition.notify_all();
+    }
+
+    void stopSearch() {
+        if (!searchThread.joinable()) {
+            return;
+        }
+        searcher.stop();
+        releaseBestMove();
+        searchThread.join();
+    }
+};
+
+// Commands given as arguments are run in order instead of reading stdin, e.g. chess-engine-uci "perft 5"
+int main(int argc, char *argv[]) {
+    UciEngine engine;
+    if (argc > 1) {
+        for (int i = 1; i < argc && engine.execute(argv[i]); i++) {
+        }
+        engine.execute("stop");
+    } else {
+        engine.run();
+    }
+    return engine.hasFailed() ? 1 : 0;
+}